@@ -0,0 +1,33 @@
+# Imports every module of the library once and prints the heap each one kept, as CSV.
+# pyhost prints the wall and cpu time of the whole script on exit; run it from the directory holding
+# python-lib, once with a plain build and once with FROZEN=1, to compare:
+#   host/build/pyhost host/import_bench.py
+# On the device, copy it to sdmc:/python-work, it reads sdmc:/python-lib there.
+import gc
+import os
+import sys
+
+for lib in ("python-lib", "sdmc:/python-lib"):
+    try:
+        names = sorted(os.listdir(lib))
+        break
+    except OSError:
+        pass
+else:
+    raise SystemExit("no python-lib directory")
+
+frozen = ".frozen" in sys.path
+print("module,frozen,heap_bytes")
+total = 0
+for name in names:
+    if name.startswith("."):
+        continue
+    module = name.rsplit(".", 1)[0] if name.endswith((".py", ".mpy")) else name
+    gc.collect()
+    before = gc.mem_alloc()
+    __import__(module)
+    gc.collect()
+    kept = gc.mem_alloc() - before
+    total += kept
+    print("%s,%d,%d" % (module, frozen, kept))
+print("total,%d,%d" % (frozen, total))
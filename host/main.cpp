@@ -0,0 +1,163 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unistd.h>
+
+#include "python_handler.h"
+
+extern "C" {
+#include "py/repl.h"
+}
+
+// what an old 3DS leaves to an application, so heap.cfg defaults come out the same as on the device
+static constexpr std::size_t DEVICE_FREE_MEMORY = 64 * 1024 * 1024;
+
+// prints output until the handler is done with the current line
+static void drain(python_handler& handler)
+{
+    std::string_view current_read;
+    int status;
+    while((status = handler.read(current_read)) != 0)
+    {
+        if(status == 1)
+        {
+            fwrite(current_read.data(), 1, current_read.size(), stdout);
+            handler.consume(current_read.size());
+        }
+        else
+        {
+            ctr::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+    fflush(stdout);
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+        "usage: %s [-c heap.cfg] [-l output.log] [-t time_limit_ms] [-i vm_tick_limit] [-p profile.folded] [script.py ...]\n"
+        "runs each script in turn and prints what it cost, or reads lines from stdin like the REPL\n"
+        "-p profiles everything that runs, the folded stacks get written on exit; needs a PROFILER=1 build\n",
+        name);
+}
+
+int main(int argc, char** argv)
+{
+    const char* heap_config_path = "";
+    output_log::settings log_settings{};
+    const char* time_limit = nullptr;
+    const char* vm_tick_limit = nullptr;
+    const char* profile_path = nullptr;
+    int opt;
+    while((opt = getopt(argc, argv, "c:l:t:i:p:h")) != -1)
+    {
+        switch(opt)
+        {
+        case 'c':
+            heap_config_path = optarg;
+            break;
+        case 'l':
+            log_settings.path = optarg;
+            break;
+        case 't':
+            time_limit = optarg;
+            break;
+        case 'i':
+            vm_tick_limit = optarg;
+            break;
+        case 'p':
+            profile_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    // the working directory stands in for the SD card folders
+    char cwd[1024];
+    if(!getcwd(cwd, sizeof(cwd)))
+    {
+        perror("getcwd");
+        return 1;
+    }
+    std::string_view import_search_paths[] = {
+#if MICROPY_MODULE_FROZEN
+        ".frozen",
+#endif
+        cwd,
+    };
+
+    const heap_config memory = heap_config::load(heap_config_path, DEVICE_FREE_MEMORY);
+    python_handler handler(import_search_paths, log_settings, memory);
+    if(time_limit || vm_tick_limit)
+    {
+        handler.set_run_limits(time_limit ? strtoul(time_limit, nullptr, 10) : memory.time_limit_ms,
+            vm_tick_limit ? strtoul(vm_tick_limit, nullptr, 10) : memory.vm_tick_limit);
+    }
+    // wait for the interpreter to be set up
+    drain(handler);
+    if(profile_path)
+    {
+        handler.set_profile_path(profile_path);
+        if(!handler.toggle_profiler())
+        {
+            return 1;
+        }
+    }
+
+    if(optind < argc)
+    {
+        for(int i = optind; i < argc && !handler.should_exit(); ++i)
+        {
+            char* path = realpath(argv[i], nullptr);
+            if(!path)
+            {
+                perror(argv[i]);
+                return 1;
+            }
+            // a line starting with a NUL is a file to run, see python_handler::loop_func
+            std::string line(1, '\0');
+            line += path;
+            free(path);
+
+            handler.write(line);
+            drain(handler);
+            if(const auto run = handler.last_run())
+            {
+                fprintf(stderr, "%s: wall %.3f ms, cpu %.3f ms, %llu vm ticks%s\n", argv[i],
+                    run->wall_us / 1000.0, run->cpu_us / 1000.0, (unsigned long long)run->vm_ticks,
+                    run->over_budget ? ", over budget" : "");
+            }
+        }
+    }
+    else
+    {
+        std::string input;
+        char buf[1024];
+        while(!handler.should_exit() && fgets(buf, sizeof(buf), stdin))
+        {
+            if(!input.empty())
+            {
+                input += '\n';
+            }
+            input.append(buf, strcspn(buf, "\n"));
+            if(mp_repl_continue_with_input(input.c_str()))
+            {
+                continue;
+            }
+            handler.write(input);
+            drain(handler);
+            input.clear();
+        }
+    }
+
+    const auto stats = handler.output_stats();
+    fprintf(stderr, "output: %llu bytes, %llu dropped, %llu stalls for %llu us\n",
+        (unsigned long long)stats.bytes_written, (unsigned long long)stats.bytes_dropped,
+        (unsigned long long)stats.stalls, (unsigned long long)stats.stall_us);
+    return handler.should_exit().value_or(0);
+}
@@ -0,0 +1,256 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <new>
+#include <unistd.h>
+
+#include "screen.h"
+#include "headless_backend.h"
+
+// how application::read_output hands output to the screen
+static constexpr std::size_t READ_SLICE = 4096;
+
+// every allocation the process makes, to tell how much of it printing causes
+static std::size_t allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    if(void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// the corpora are generated the same way every run, so results stay comparable between builds
+struct corpus {
+    const char* name;
+    std::string text;
+    std::size_t rows;
+};
+
+static std::size_t count_rows(const std::string& text)
+{
+    std::size_t rows = 0;
+    for(const char c : text)
+    {
+        rows += c == '\n';
+    }
+    return rows;
+}
+
+// for i in range(n): print(i, "...")
+static corpus print_loop()
+{
+    std::string text;
+    for(int i = 0; i < 20000; ++i)
+    {
+        text += std::to_string(i);
+        text += " the quick brown fox jumps over the lazy dog\n";
+    }
+    return {"print_loop", text, count_rows(text)};
+}
+
+// uncaught exceptions as do_run prints them, red around the traceback
+static corpus tracebacks()
+{
+    std::string text;
+    for(int i = 0; i < 2000; ++i)
+    {
+        text += "\e[31mTraceback (most recent call last):\n";
+        text += "  File \"sdmc:/python-work/main.py\", line " + std::to_string(10 + i % 50) + ", in <module>\n";
+        text += "  File \"sdmc:/python-lib/ui.py\", line " + std::to_string(100 + i % 7) + ", in draw\n";
+        text += "  File \"sdmc:/python-lib/ui.py\", line 42, in text_width\n";
+        text += "ValueError: can't measure glyph " + std::to_string(i) + "\n";
+        text += "\e[0m";
+    }
+    return {"tracebacks", text, count_rows(text)};
+}
+
+// a full screen TUI redrawn in place: home, then each row rewritten and the rest of it erased
+static corpus cursor_tui()
+{
+    // what fits on the default 400x240 screen
+    constexpr int TUI_ROWS = 20;
+    std::string text;
+    for(int frame = 0; frame < 1000; ++frame)
+    {
+        text += "\e[H";
+        text += "\e[7m status: frame " + std::to_string(frame) + " \e[0m\e[K\r\n";
+        for(int row = 2; row <= TUI_ROWS; ++row)
+        {
+            text += "\e[" + std::to_string(row) + ";3H";
+            text += "item " + std::to_string((frame + row) % 97) + (row % 4 == 0 ? " [x]" : " [ ]");
+            text += "\e[K";
+        }
+    }
+    return {"cursor_tui", text, std::size_t(1000) * TUI_ROWS};
+}
+
+// 256-color and 24-bit SGR on every few cells, foreground and background
+static corpus sgr_colors()
+{
+    std::string text;
+    for(int i = 0; i < 8000; ++i)
+    {
+        for(int cell = 0; cell < 8; ++cell)
+        {
+            const int n = (i * 8 + cell) & 0xff;
+            if(cell & 1)
+            {
+                text += "\e[38;2;" + std::to_string(n) + ";" + std::to_string(255 - n) + ";" + std::to_string((n * 7) & 0xff) + "m";
+                text += "\e[48;2;0;0;" + std::to_string(n / 4) + "m";
+            }
+            else
+            {
+                text += "\e[38;5;" + std::to_string(n) + ";48;5;" + std::to_string(255 - n) + "m";
+            }
+            text += "text";
+        }
+        text += "\e[0m\n";
+    }
+    return {"sgr_colors", text, count_rows(text)};
+}
+
+struct result {
+    const char* corpus;
+    const char* mode;
+    std::size_t bytes, rows;
+    double seconds;
+    std::size_t allocations;
+    std::size_t draw_calls;
+};
+
+// per_slice draws after every slice, like a frame that only had time for one;
+// fast_forward draws once at the end, the way application::read_output catches up on a backlog
+static result run(const corpus& c, bool per_slice, int repeats)
+{
+    headless_backend backend;
+    screen scr(backend);
+    const auto feed = [&]() {
+        std::size_t draw_calls = 0;
+        for(std::size_t pos = 0; pos < c.text.size(); pos += READ_SLICE)
+        {
+            scr.print(std::string_view(c.text).substr(pos, READ_SLICE));
+            if(per_slice || pos + READ_SLICE >= c.text.size())
+            {
+                scr.tick();
+                scr.draw();
+                draw_calls += backend.commands().size();
+                backend.clear_commands();
+            }
+        }
+        return draw_calls;
+    };
+    // once to fill the scrollback and grow the buffers, the steady state is what's measured
+    feed();
+
+    const std::size_t allocations_before = allocations;
+    std::size_t draw_calls = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < repeats; ++i)
+    {
+        draw_calls += feed();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return {c.name, per_slice ? "per_slice" : "fast_forward", c.text.size() * repeats, c.rows * repeats,
+        elapsed.count(), allocations - allocations_before, draw_calls};
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+        "usage: %s [-f json|csv] [-n repeats]\n"
+        "feeds fixed output corpora through screen and the headless backend, prints bytes/s, rows/s and\n"
+        "allocations per KB for each, drawing after every %zu byte slice and only at the end\n",
+        name, READ_SLICE);
+}
+
+int main(int argc, char** argv)
+{
+    bool csv = false;
+    int repeats = 5;
+    int opt;
+    while((opt = getopt(argc, argv, "f:n:h")) != -1)
+    {
+        switch(opt)
+        {
+        case 'f':
+            csv = strcmp(optarg, "csv") == 0;
+            if(!csv && strcmp(optarg, "json") != 0)
+            {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'n':
+            repeats = atoi(optarg);
+            if(repeats <= 0)
+            {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    const corpus corpora[] = {
+        print_loop(),
+        tracebacks(),
+        cursor_tui(),
+        sgr_colors(),
+    };
+    std::vector<result> results;
+    for(const auto& c : corpora)
+    {
+        results.push_back(run(c, true, repeats));
+        results.push_back(run(c, false, repeats));
+    }
+
+    if(csv)
+    {
+        printf("corpus,mode,bytes,rows,seconds,bytes_per_s,rows_per_s,allocs_per_kb,draw_calls\n");
+    }
+    else
+    {
+        printf("[\n");
+    }
+    for(std::size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& r = results[i];
+        const double bytes_per_s = r.bytes / r.seconds, rows_per_s = r.rows / r.seconds;
+        const double allocs_per_kb = r.allocations / (r.bytes / 1024.0);
+        if(csv)
+        {
+            printf("%s,%s,%zu,%zu,%.6f,%.0f,%.0f,%.4f,%zu\n", r.corpus, r.mode, r.bytes, r.rows, r.seconds,
+                bytes_per_s, rows_per_s, allocs_per_kb, r.draw_calls);
+        }
+        else
+        {
+            printf("  {\"corpus\": \"%s\", \"mode\": \"%s\", \"bytes\": %zu, \"rows\": %zu, \"seconds\": %.6f, "
+                "\"bytes_per_s\": %.0f, \"rows_per_s\": %.0f, \"allocs_per_kb\": %.4f, \"draw_calls\": %zu}%s\n",
+                r.corpus, r.mode, r.bytes, r.rows, r.seconds, bytes_per_s, rows_per_s, allocs_per_kb, r.draw_calls,
+                i + 1 < results.size() ? "," : "");
+        }
+    }
+    if(!csv)
+    {
+        printf("]\n");
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "check.h"
+#include "byte_ring.h"
+
+// every allocation made while the ring is in use, there shouldn't be any
+static std::atomic<std::size_t> allocations{0};
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// byte n of the stream, so the consumer can tell a lost, doubled or torn byte anywhere in it
+static char stream_byte(std::size_t n)
+{
+    return char(n * 31 + (n >> 11));
+}
+
+int main()
+{
+    // single threaded: rounding, filling up and wrapping around the end of the storage
+    {
+        byte_ring ring(1000);
+        CHECK(ring.capacity() == 1024);
+        CHECK(ring.empty() && ring.free_space() == 1024);
+        const std::string big(1500, 'x');
+        CHECK(ring.write(big) == 1024);
+        CHECK(ring.write("y") == 0);
+        CHECK(ring.readable().size() == 1024);
+        ring.consume(1000);
+        CHECK(ring.size() == 24);
+        CHECK(ring.write("0123456789") == 10);
+        // what's past the end comes as a second slice
+        CHECK(ring.readable().size() == 24);
+        ring.consume(24);
+        CHECK(ring.readable() == "0123456789");
+        ring.consume(10);
+        CHECK(ring.empty() && ring.readable().empty());
+    }
+
+    // one producer printing in fragments the way MicroPython does, one consumer draining whatever is there
+    constexpr std::size_t TOTAL = 64 << 20;
+    byte_ring ring(16 * 1024);
+    std::atomic<bool> go{false};
+    std::thread producer([&]() {
+        char buf[256];
+        while(!go.load(std::memory_order_acquire))
+            std::this_thread::yield();
+        std::size_t n = 0, fragment = 0;
+        while(n < TOTAL)
+        {
+            // mostly a few bytes at a time, a long line now and then
+            const std::size_t len = std::min<std::size_t>(++fragment % 64 == 0 ? 256 : 1 + fragment % 13, TOTAL - n);
+            for(std::size_t i = 0; i < len; ++i)
+                buf[i] = stream_byte(n + i);
+            std::string_view rest(buf, len);
+            while(!rest.empty())
+            {
+                const std::size_t written = ring.write(rest);
+                // full, the consumer may need this core to get on
+                if(!written)
+                    std::this_thread::yield();
+                rest.remove_prefix(written);
+            }
+            n += len;
+        }
+    });
+
+    const std::size_t allocations_before = allocations.load();
+    std::size_t got = 0, slices = 0, bad = 0;
+    const double seconds = time_s([&]() {
+        go.store(true, std::memory_order_release);
+        while(got < TOTAL)
+        {
+            const auto slice = ring.readable();
+            if(slice.empty())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for(std::size_t i = 0; i < slice.size(); ++i)
+                bad += slice[i] != stream_byte(got + i);
+            got += slice.size();
+            ++slices;
+            ring.consume(slice.size());
+        }
+        producer.join();
+    });
+    CHECK(bad == 0);
+    CHECK(got == TOTAL);
+    CHECK(ring.empty());
+    CHECK(allocations.load() == allocations_before);
+    printf("byte_ring: %.1f MB/s from one thread to another in fragments of 1 to 256 bytes, %.0f bytes per slice read\n",
+        TOTAL / seconds / 1e6, double(TOTAL) / slices);
+    return check_result("byte_ring");
+}
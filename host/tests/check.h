@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdio>
+#include <chrono>
+
+// the tests are plain programs: a failed CHECK is reported and the test goes on, main returns check_result()
+inline int check_failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++check_failures; \
+        } \
+    } while(0)
+
+inline int check_result(const char* name)
+{
+    printf("%s: %s\n", name, check_failures ? "FAILED" : "ok");
+    return check_failures != 0;
+}
+
+// seconds f takes, for the throughput lines printed next to the checks; they're never checked against anything
+template<typename F>
+double time_s(F&& f)
+{
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <string>
+
+#include "check.h"
+#include "headless_backend.h"
+#include "screen.h"
+
+using kind = headless_backend::command::kind;
+
+static std::size_t row_rects(const headless_backend& backend, std::size_t slot)
+{
+    const auto& cmds = backend.row_commands(slot);
+    return std::count_if(cmds.begin(), cmds.end(), [](const auto& c) { return c.type == kind::rect; });
+}
+
+// backgrounds: one rect per run of same-colored cells, none where the clear color shows anyway
+int main()
+{
+    headless_backend backend;
+    screen scr(backend);
+    const std::size_t ROWS = scr.rows(), COLS = scr.columns();
+
+    // slots are physical rows, which are the screen rows until something scrolls
+    scr.print("plain text on the default background\r\n");
+    scr.print("\e[41mAAAA\e[42mBBBB\e[0m after\r\n");
+    scr.print("\e[44m\e[K\e[0m\r\n");
+    scr.print("\e[41mA\e[0m \e[41mB\e[0m\r\n");
+    scr.tick();
+    scr.draw();
+    CHECK(row_rects(backend, 0) == 0);
+    CHECK(row_rects(backend, 1) == 2);
+    {
+        const auto& cmds = backend.row_commands(1);
+        // the headless backend's glyphs are exactly a cell wide
+        const auto rect = std::find_if(cmds.begin(), cmds.end(), [](const auto& c) { return c.type == kind::rect; });
+        const auto glyph = std::find_if(cmds.begin(), cmds.end(), [](const auto& c) { return c.type == kind::glyph; });
+        CHECK(rect != cmds.end() && glyph != cmds.end() && rect->x == 0.0f && rect->w == 4 * glyph->w);
+    }
+    CHECK(row_rects(backend, 2) == 1);
+    CHECK(row_rects(backend, 3) == 2);
+
+    // a screen full of REPL output: one draw per row and the cursor, nothing per cell
+    backend.clear_commands();
+    for(std::size_t i = 0; i < ROWS * 4; ++i)
+    {
+        scr.print(">>> print(i)\r\n" + std::to_string(i) + "\r\n");
+    }
+    scr.tick();
+    std::size_t draw_calls = 0, rects = 0;
+    const double seconds = time_s([&]() {
+        scr.draw();
+    });
+    draw_calls = backend.commands().size();
+    for(std::size_t slot = 0; slot < ROWS; ++slot)
+    {
+        rects += row_rects(backend, slot);
+        draw_calls += backend.row_commands(slot).size();
+    }
+    CHECK(rects == 0);
+    CHECK(backend.count(kind::row) == ROWS);
+    CHECK(backend.count(kind::rect) == 1);
+    printf("draw_batching: %zu rows x %zu columns, %zu background rects instead of %zu, %zu draw calls in %.3f ms\n",
+        ROWS, COLS, rects, ROWS * COLS, draw_calls, seconds * 1000);
+    return check_result("draw_batching");
+}
@@ -0,0 +1,51 @@
+#include <string>
+
+#include "check.h"
+#include "glyph_cache.h"
+#include "headless_backend.h"
+#include "screen.h"
+
+// each codepoint is prepared by the backend once, however often it gets printed or redrawn
+int main()
+{
+    headless_backend backend;
+    {
+        glyph_cache cache(backend);
+        CHECK(cache.lookup(' ') == glyph_cache::EMPTY);
+        CHECK(cache.lookup('\t') == glyph_cache::EMPTY);
+        const auto a = cache.lookup('a');
+        const auto snowman = cache.lookup(U'☃');
+        CHECK(a != glyph_cache::EMPTY && snowman != glyph_cache::EMPTY && a != snowman);
+        CHECK(cache.lookup('a') == a);
+        CHECK(cache.lookup(U'☃') == snowman);
+        CHECK(cache.codepoint(a) == 'a');
+        CHECK(cache.codepoint(snowman) == U'☃');
+        CHECK(cache.size() == 2);
+        CHECK(backend.glyph_loads() == 2);
+    }
+
+    headless_backend screen_backend;
+    screen scr(screen_backend);
+    const std::string line = "0123456789 abcdefghijklmnopqrstuvwxyz \xc3\xa9\xe2\x98\x83\n";
+    // digits, letters, e acute and the snowman, and the 'O' screen measures cells with
+    const std::size_t distinct = 10 + 26 + 2 + 1;
+    constexpr int LINES = 20000;
+    const double seconds = time_s([&]() {
+        for(int i = 0; i < LINES; ++i)
+        {
+            scr.print(line);
+            if(i % 16 == 0)
+            {
+                scr.tick();
+                scr.draw();
+                screen_backend.clear_commands();
+            }
+        }
+        scr.tick();
+        scr.draw();
+    });
+    CHECK(screen_backend.glyph_loads() == distinct);
+    printf("glyph_cache: %d rows printed and laid out in %.1f ms, %.0f rows/s, %zu glyph loads\n",
+        LINES, seconds * 1000, LINES / seconds, screen_backend.glyph_loads());
+    return check_result("glyph_cache");
+}
@@ -0,0 +1,63 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+#include "check.h"
+#include "heap_config.h"
+
+static constexpr std::size_t KIB = 1024, MIB = 1024 * KIB;
+
+static heap_config load_text(const std::string& text, std::size_t free_memory)
+{
+    char path[] = "/tmp/heap_cfgXXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    CHECK(write(fd, text.data(), text.size()) == ssize_t(text.size()));
+    close(fd);
+    const heap_config conf = heap_config::load(path, free_memory);
+    unlink(path);
+    return conf;
+}
+
+int main()
+{
+    // no file: an eighth of what's free to start, clamped to 1..8 MiB, growing up to half of it
+    {
+        const heap_config conf = heap_config::load("/nonexistent/heap.cfg", 64 * MIB);
+        CHECK(conf.heap_size == 8 * MIB);
+        CHECK(conf.heap_max == 32 * MIB);
+        CHECK(conf.time_limit_ms == 0 && conf.vm_tick_limit == 0);
+        const heap_config small = heap_config::load("/nonexistent/heap.cfg", 4 * MIB);
+        CHECK(small.heap_size == 1 * MIB);
+        CHECK(small.heap_max == 2 * MIB);
+    }
+
+    // what's set is taken, what isn't keeps its default, nonsense is skipped
+    {
+        const heap_config conf = load_text(
+            "# heap.cfg\n"
+            "heap_kb = 512\n"
+            "  exec_kb=64   # native code\r\n"
+            "time_limit_ms = 2500\n"
+            "vm_tick_limit = 0\n"
+            "heap_max_kb = lots\n"
+            "colour = blue\n"
+            "no equals sign\n",
+            64 * MIB);
+        CHECK(conf.heap_size == 512 * KIB);
+        CHECK(conf.heap_max == 32 * MIB);
+        CHECK(conf.exec_size == 64 * KIB);
+        CHECK(conf.time_limit_ms == 2500);
+        CHECK(conf.vm_tick_limit == 0);
+    }
+
+    // a maximum below the start means a heap that never grows, and the stack has a floor
+    {
+        const heap_config conf = load_text("heap_kb = 2048\nheap_max_kb = 1024\nstack_kb = 4\n", 64 * MIB);
+        CHECK(conf.heap_size == 2 * MIB);
+        CHECK(conf.heap_max == 2 * MIB);
+        CHECK(conf.stack_size == 16 * KIB);
+    }
+    return check_result("heap_config");
+}
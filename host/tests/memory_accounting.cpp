@@ -0,0 +1,102 @@
+#include <string>
+
+#include "check.h"
+#include "headless_backend.h"
+#include "screen.h"
+#include "scrollback.h"
+
+// what a cell cost before the grid was packed: a screen::character (a 28 byte C2D_Text, two u32 colors and a
+// flag) and its codepoint in the row's text, not even counting the per-row C2D_TextBuf the glyphs lived in
+static constexpr std::size_t OLD_CELL_BYTES = 40 + 4;
+
+static void fill(screen& scr, std::size_t lines)
+{
+    const std::string text(scr.columns() - 1, 'x');
+    for(std::size_t i = 0; i < lines; ++i)
+    {
+        scr.print("\e[3" + std::to_string(i % 8) + "m" + text + "\r\n");
+    }
+    scr.tick();
+    scr.draw();
+}
+
+int main()
+{
+    headless_backend backend;
+    constexpr std::size_t DEPTH = 1000;
+    screen scr(backend, DEPTH);
+
+    // the grid at both text scales: packed cells and row text, a quarter of the old cost at most
+    for(const float scale : {0.75f, 0.5f})
+    {
+        scr.set_text_scale(scale);
+        fill(scr, scr.rows());
+        const std::size_t cells = scr.rows() * scr.columns();
+        const std::size_t used = scr.memory_usage();
+        CHECK(used * 4 <= cells * OLD_CELL_BYTES);
+        printf("memory_accounting: %zux%zu grid at scale %.2f takes %zu bytes, %.1f per cell against %zu\n",
+            scr.columns(), scr.rows(), scale, used, double(used) / cells, OLD_CELL_BYTES);
+    }
+    scr.set_text_scale(0.75f);
+
+    // the scrollback keeps DEPTH lines, and stops growing once it does
+    fill(scr, DEPTH * 2);
+    CHECK(scr.scrollback_size() == DEPTH);
+    const std::size_t full = scr.scrollback_memory();
+    fill(scr, DEPTH);
+    CHECK(scr.scrollback_size() == DEPTH);
+    CHECK(scr.scrollback_memory() <= full);
+    CHECK(full <= DEPTH * scrollback::max_line_bytes());
+    printf("memory_accounting: %zu lines of %zu columns in scrollback take %zu bytes, %.1f per line\n",
+        DEPTH, scr.columns() - 1, full, double(full) / DEPTH);
+
+    // paging through the scrollback costs a second grid only while it's shown
+    const std::size_t live = scr.memory_usage();
+    scr.scroll_back(scr.rows());
+    scr.tick();
+    scr.draw();
+    CHECK(scr.memory_usage() > live);
+    scr.reset_view();
+    CHECK(scr.memory_usage() == live);
+
+    // changing the depth starts the scrollback over, and gives its memory back
+    scr.set_scrollback_depth(DEPTH / 10);
+    CHECK(scr.scrollback_size() == 0);
+    CHECK(scr.scrollback_memory() < full / 100);
+
+    // 24bit colors: a full table falls back to the palette, entries nothing uses anymore come back into use
+    {
+        headless_backend tc_backend;
+        screen tc(tc_backend, 50);
+        const auto sgr = [](unsigned n) {
+            return "\e[38;2;" + std::to_string(n & 0xff) + ";" + std::to_string(n >> 8) + ";7m";
+        };
+        // the color of the cell at the top left, as drawn
+        const auto top_left_color = [&]() {
+            tc.tick();
+            tc.draw();
+            u32 color = 0;
+            for(const auto& row : tc_backend.commands())
+            {
+                if(row.type == headless_backend::command::kind::row && row.y == 0.0f)
+                    color = tc_backend.row_commands(row.codepoint).front().color;
+            }
+            tc_backend.clear_commands();
+            return color;
+        };
+        for(unsigned n = 0; n < screen::MAX_TRUECOLORS; ++n)
+            tc.print(sgr(n) + "x");
+        tc.print(sgr(1000) + "\r\ny");
+        CHECK(!(tc.cells.attrs[tc.cursor_y * tc.cells.width] & screen::ATTR_FG_TRUECOLOR));
+
+        // scrolled out of a 50 line scrollback, printing past the rescan interval
+        for(int i = 0; i < 100; ++i)
+            tc.print("\e[0m" + std::string(60, '-') + "\r\n");
+        tc.print("\e[H\e[2J" + sgr(1001) + "z");
+        CHECK(top_left_color() == color32(1001 & 0xff, 1001 >> 8, 7, 255));
+        // and the colors still shown keep theirs
+        tc.print("\e[H" + sgr(5) + "a" + sgr(1002) + "b" + sgr(5) + "c");
+        CHECK(top_left_color() == color32(5, 0, 7, 255));
+    }
+    return check_result("memory_accounting");
+}
@@ -0,0 +1,74 @@
+#include <random>
+#include <string>
+
+#include "check.h"
+#include "headless_backend.h"
+#include "screen.h"
+
+// the bulk path for plain runs has to leave the screen exactly as one character at a time would
+static bool same_screen(screen& a, screen& b)
+{
+    a.tick();
+    b.tick();
+    if(a.cursor_x != b.cursor_x || a.cursor_y != b.cursor_y || a.scroll_x != b.scroll_x)
+        return false;
+    for(std::size_t i = 0; i < a.row_elems.size(); ++i)
+    {
+        if(a.row_elems[i].value != b.row_elems[i].value || a.row_elems[i].wrapped != b.row_elems[i].wrapped)
+            return false;
+    }
+    return a.cells.glyph == b.cells.glyph && a.cells.fg == b.cells.fg && a.cells.bg == b.cells.bg && a.cells.attrs == b.cells.attrs;
+}
+
+static double mb_per_s(const std::string& text)
+{
+    headless_backend backend;
+    screen scr(backend);
+    const double seconds = time_s([&]() {
+        for(std::size_t pos = 0; pos < text.size(); pos += 4096)
+            scr.print(std::string_view(text).substr(pos, 4096));
+    });
+    return text.size() / seconds / 1e6;
+}
+
+int main()
+{
+    std::mt19937 rng(6);
+    for(int round = 0; round < 200; ++round)
+    {
+        // runs shorter and longer than a row, colors between them, with and without autowrap
+        std::string text = round % 2 ? "\e[?7l" : "";
+        for(int i = 0; i < 30; ++i)
+        {
+            text += std::string(rng() % 120, char('a' + rng() % 26));
+            switch(rng() % 4)
+            {
+            case 0:
+                text += "\r\n";
+                break;
+            case 1:
+                text += "\e[3" + std::to_string(rng() % 8) + "m";
+                break;
+            case 2:
+                text += "\xe2\x98\x83";
+                break;
+            }
+        }
+
+        headless_backend bulk_backend, single_backend;
+        screen bulk(bulk_backend), single(single_backend);
+        bulk.print(text);
+        for(const char c : text)
+            single.print(std::string_view(&c, 1));
+        CHECK(same_screen(bulk, single));
+    }
+
+    std::string long_lines, short_lines;
+    while(long_lines.size() < (8 << 20))
+        long_lines += std::string(200, 'x') + "\r\n";
+    while(short_lines.size() < (8 << 20))
+        short_lines += "Traceback line " + std::to_string(short_lines.size() % 1000) + "\r\n";
+    printf("print_throughput: %.1f MB/s for 200 column lines, %.1f MB/s for short lines\n",
+        mb_per_s(long_lines), mb_per_s(short_lines));
+    return check_result("print_throughput");
+}
@@ -0,0 +1,106 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "check.h"
+#include "session.h"
+
+// the same loop three ways, kept inside 31 bits so viper's machine words give what python's ints do
+static const char* const LOOPS = R"(
+import micropython
+import time
+
+def loop_bytecode(n):
+    s = 0
+    i = 0
+    while i < n:
+        s += (i & 1023) ^ (s & 7)
+        i += 1
+    return s
+
+@micropython.native
+def loop_native(n):
+    s = 0
+    i = 0
+    while i < n:
+        s += (i & 1023) ^ (s & 7)
+        i += 1
+    return s
+
+@micropython.viper
+def loop_viper(n: int) -> int:
+    s = 0
+    i = 0
+    while i < n:
+        s += (i & 1023) ^ (s & 7)
+        i += 1
+    return s
+
+def timed(f):
+    t = time.ticks_us()
+    r = f(300000)
+    return r, time.ticks_diff(time.ticks_us(), t)
+
+rb, tb = timed(loop_bytecode)
+rn, tn = timed(loop_native)
+rv, tv = timed(loop_viper)
+print("same", int(rb == rn == rv))
+print("bytecode", tb)
+print("native", tn)
+print("viper", tv)
+)";
+
+// native functions until the executable region is full
+static const char* const FILL = R"(
+n = 0
+try:
+    while True:
+        exec("@micropython.native\ndef f%d(x):\n    return x * %d + 1\n" % (n, n))
+        n += 1
+except MemoryError:
+    print("MemoryError after", n)
+print("f1", f1(2))
+)";
+
+static long field(const std::string& out, const char* name)
+{
+    const auto at = out.find(std::string(name) + " ");
+    return at == std::string::npos ? -1 : std::strtol(out.c_str() + at + std::strlen(name) + 1, nullptr, 10);
+}
+
+int main()
+{
+    const heap_config memory = heap_config::load("", DEVICE_FREE_MEMORY);
+    long bytecode_us, native_us, viper_us;
+    {
+        python_session py(memory);
+        const std::string out = py.run(LOOPS);
+        CHECK(field(out, "same") == 1);
+        bytecode_us = field(out, "bytecode");
+        native_us = field(out, "native");
+        viper_us = field(out, "viper");
+        CHECK(native_us > 0 && native_us < bytecode_us);
+        CHECK(viper_us > 0 && viper_us < native_us);
+    }
+
+    // a full region is a MemoryError, and what was committed before it goes on working;
+    // the region is mapped once per process, so the first session's code is gone by now
+    long fitted;
+    {
+        python_session py(memory);
+        const std::string out = py.run(FILL);
+        fitted = field(out, "MemoryError after");
+        CHECK(fitted > 1);
+        CHECK(field(out, "f1") == 3);
+    }
+    // the next interpreter gets the whole region back
+    {
+        python_session py(memory);
+        CHECK(field(py.run(FILL), "MemoryError after") == fitted);
+    }
+
+    printf("emitters: the same loop takes %.1f ms as bytecode, %.1f ms native (%.1fx), %.1f ms viper (%.1fx)\n",
+        bytecode_us / 1000.0, native_us / 1000.0, double(bytecode_us) / native_us,
+        viper_us / 1000.0, double(bytecode_us) / viper_us);
+    return check_result("emitters");
+}
@@ -0,0 +1,60 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <chrono>
+
+#include "check.h"
+#include "session.h"
+
+// how late 1 ms sleeps wake up, on average and at worst
+static const char* const SLEEPS = R"(
+import time
+worst = 0
+total = 0
+for i in range(200):
+    t = time.ticks_us()
+    time.sleep_ms(1)
+    late = time.ticks_diff(time.ticks_us(), t) - 1000
+    total += late
+    worst = max(worst, late)
+print("late", total // 200)
+print("worst", worst)
+)";
+
+static long field(const std::string& out, const char* name)
+{
+    const auto at = out.find(std::string(name) + " ");
+    return at == std::string::npos ? -1 : std::strtol(out.c_str() + at + std::strlen(name) + 1, nullptr, 10);
+}
+
+int main()
+{
+    python_session py(heap_config::load("", DEVICE_FREE_MEMORY));
+
+    // the old poll hook slept in 250 us steps, a wakeup could be that late on top of the sleep itself
+    const std::string out = py.run(SLEEPS);
+    const long late_us = field(out, "late"), worst_us = field(out, "worst");
+    CHECK(late_us >= 0 && late_us < 250);
+
+    // sleeping isn't running
+    py.run("import time\ntime.sleep_ms(500)\n");
+    const auto idle = py.handler.last_run();
+    CHECK(idle && idle->wall_us >= 500000);
+    CHECK(idle && idle->cpu_us * 10 < idle->wall_us);
+
+    // an interrupt ends a long sleep as soon as it's signaled
+    py.start("import time\ntime.sleep(30)\n");
+    ctr::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::string interrupted;
+    const double interrupt_ms = time_s([&]() {
+        py.handler.signal_interrupt();
+        interrupted = py.drain();
+    }) * 1000;
+    CHECK(interrupted.find("KeyboardInterrupt") != std::string::npos);
+    CHECK(interrupt_ms < 1000);
+
+    printf("event_latency: 1 ms sleeps wake %ld us late on average, %ld us at worst; idle cpu %.1f ms over %.1f ms; "
+        "an interrupt ends a sleep in %.2f ms\n",
+        late_us, worst_us, idle ? idle->cpu_us / 1000.0 : 0.0, idle ? idle->wall_us / 1000.0 : 0.0, interrupt_ms);
+    return check_result("event_latency");
+}
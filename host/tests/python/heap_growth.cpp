@@ -0,0 +1,66 @@
+#include <string>
+
+#include "check.h"
+#include "session.h"
+
+// keeps 3 MiB alive in 64 KiB pieces, far past the first area
+static const char* const FILL = R"(
+import gcstats
+keep = []
+try:
+    for i in range(48):
+        keep.append(bytearray(64 * 1024))
+    print("kept", len(keep))
+except MemoryError:
+    print("MemoryError at", len(keep))
+print("heap_total", gcstats.stats()["heap_total"])
+)";
+
+// short lived lists, a few hundred KiB alive at any time
+static const char* const CHURN = R"(
+t = []
+for i in range(200000):
+    t.append([i] * 8)
+    if len(t) > 2000:
+        t = []
+)";
+
+static heap_config config(std::size_t heap_kb, std::size_t heap_max_kb)
+{
+    heap_config memory = heap_config::load("", DEVICE_FREE_MEMORY);
+    memory.heap_size = heap_kb * 1024;
+    memory.heap_max = heap_max_kb * 1024;
+    return memory;
+}
+
+int main()
+{
+    // a heap that may grow takes in what a fixed one of the same start can't
+    {
+        python_session py(config(256, 8 * 1024));
+        const std::string out = py.run(FILL);
+        CHECK(out.find("kept 48") != std::string::npos);
+        const auto at = out.find("heap_total ");
+        CHECK(at != std::string::npos && std::stoul(out.substr(at + 11)) >= 3 * 1024 * 1024);
+    }
+    {
+        python_session py(config(256, 256));
+        const std::string out = py.run(FILL);
+        CHECK(out.find("MemoryError at") != std::string::npos);
+        const auto at = out.find("heap_total ");
+        CHECK(at != std::string::npos && std::stoul(out.substr(at + 11)) == 256 * 1024);
+    }
+
+    // the same churn on a fixed 1 MiB heap and on one starting at 256 KiB, collections against growth
+    const auto churn_ms = [](const heap_config& memory) {
+        python_session py(memory);
+        CHECK(py.run(CHURN).find("Error") == std::string::npos);
+        const auto run = py.handler.last_run();
+        CHECK(run.has_value());
+        return run ? run->wall_us / 1000.0 : 0.0;
+    };
+    const double fixed_ms = churn_ms(config(1024, 1024)), growable_ms = churn_ms(config(256, 8 * 1024));
+    printf("heap_growth: allocation churn takes %.1f ms on a fixed 1 MiB heap, %.1f ms on one growing from 256 KiB\n",
+        fixed_ms, growable_ms);
+    return check_result("heap_growth");
+}
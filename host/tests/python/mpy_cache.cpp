@@ -0,0 +1,165 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <ctime>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "session.h"
+
+// a library of many modules, each with enough code in it that compiling shows
+static constexpr int MODULES = 40;
+
+static std::string dir;
+
+// the key vfs_mpycache.c appends to each .mpy, and where in it the .mpy version is
+static constexpr long KEY_SIZE = 24, KEY_VERSION_AT = 4;
+
+static std::string module_path(int i, const char* ext)
+{
+    return dir + "/m" + std::to_string(i) + ext;
+}
+
+static bool exists(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+// seconds_ago keeps the source out of the window the cache won't trust, see vfs_mpycache.h
+static void write_module(int i, int value, int seconds_ago)
+{
+    std::string text = "VALUE = " + std::to_string(value) + "\n";
+    for(int f = 0; f < 30; ++f)
+    {
+        text += "def f" + std::to_string(f) + "(a, b=1, *args, **kw):\n"
+            "    x = [a * b + i for i in range(10) if i % 3]\n"
+            "    y = {k: v for k, v in kw.items() if v}\n"
+            "    return sum(x) + len(y) + len(args) + " + std::to_string(f) + "\n";
+    }
+    const std::string path = module_path(i, ".py");
+    if(FILE* f = fopen(path.c_str(), "w"))
+    {
+        fwrite(text.data(), 1, text.size(), f);
+        fclose(f);
+    }
+    const timeval times[2] = {{time(nullptr) - seconds_ago, 0}, {time(nullptr) - seconds_ago, 0}};
+    utimes(path.c_str(), times);
+}
+
+// imports every module but skip, prints the sum of their values and how long importing took
+static std::string import_all(int skip = -1)
+{
+    return
+        "import time\n"
+        "t = time.ticks_us()\n"
+        "total = 0\n"
+        "for i in range(" + std::to_string(MODULES) + "):\n"
+        "    if i != " + std::to_string(skip) + ":\n"
+        "        total += __import__('m%d' % i).VALUE\n"
+        "print('total', total, 'us', time.ticks_diff(time.ticks_us(), t))\n";
+}
+
+static long field(const std::string& out, const char* name)
+{
+    const auto at = out.find(std::string(name) + " ");
+    return at == std::string::npos ? -1 : std::strtol(out.c_str() + at + std::strlen(name) + 1, nullptr, 10);
+}
+
+int main()
+{
+    char dir_template[] = "/tmp/mpy_cacheXXXXXX";
+    if(!mkdtemp(dir_template))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    dir = dir_template;
+    const heap_config memory = heap_config::load("", DEVICE_FREE_MEMORY);
+
+    int want = 0;
+    for(int i = 0; i < MODULES; ++i)
+    {
+        write_module(i, i, 10);
+        want += i;
+    }
+
+    // the first import compiles each module and leaves its .mpy next to it
+    long compile_us, cached_us;
+    {
+        python_session py(memory, dir);
+        const std::string out = py.run(import_all());
+        CHECK(field(out, "total") == want);
+        compile_us = field(out, "us");
+    }
+    for(int i = 0; i < MODULES; ++i)
+    {
+        CHECK(exists(module_path(i, ".mpy")));
+    }
+
+    // a new interpreter loads those instead
+    {
+        python_session py(memory, dir);
+        const std::string out = py.run(import_all());
+        CHECK(field(out, "total") == want);
+        cached_us = field(out, "us");
+    }
+
+    // a .mpy written as another .mpy version is compiled again instead of handed to a loader that would refuse it
+    const std::string stale = module_path(3, ".mpy");
+    const auto trailer_byte = [&](long from_end, int value) {
+        int old = -1;
+        if(FILE* f = fopen(stale.c_str(), "r+b"))
+        {
+            fseek(f, -from_end, SEEK_END);
+            old = fgetc(f);
+            if(value >= 0)
+            {
+                fseek(f, -from_end, SEEK_END);
+                fputc(value, f);
+            }
+            fclose(f);
+        }
+        return old;
+    };
+    const int version = trailer_byte(KEY_SIZE - KEY_VERSION_AT, -1);
+    CHECK(version > 0);
+    trailer_byte(KEY_SIZE - KEY_VERSION_AT, version + 1);
+    {
+        python_session py(memory, dir);
+        CHECK(field(py.run(import_all()), "total") == want);
+    }
+    CHECK(trailer_byte(KEY_SIZE - KEY_VERSION_AT, -1) == version);
+
+    // a source that changed is compiled again, one changed a moment ago isn't trusted to the cache,
+    // and the .mpy of one that went away is removed rather than imported
+    write_module(0, 1000, 5);
+    write_module(1, 2000, 0);
+    unlink(module_path(2, ".py").c_str());
+    want = want - 0 - 1 - 2 + 1000 + 2000;
+    {
+        python_session py(memory, dir);
+        const std::string out = py.run(import_all(2) +
+            "try:\n"
+            "    import m2\n"
+            "except ImportError:\n"
+            "    print('m2 gone')\n");
+        CHECK(field(out, "total") == want);
+        CHECK(out.find("m2 gone") != std::string::npos);
+    }
+    CHECK(!exists(module_path(2, ".mpy")));
+
+    printf("mpy_cache: importing %d modules takes %.1f ms compiling, %.1f ms from their .mpy\n",
+        MODULES, compile_us / 1000.0, cached_us / 1000.0);
+
+    for(int i = 0; i < MODULES; ++i)
+    {
+        unlink(module_path(i, ".py").c_str());
+        unlink(module_path(i, ".mpy").c_str());
+    }
+    rmdir(dir.c_str());
+    return check_result("mpy_cache");
+}
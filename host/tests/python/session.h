@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+#include <unistd.h>
+
+#include "python_handler.h"
+
+// what an old 3DS leaves to an application, as in main.cpp
+inline constexpr std::size_t DEVICE_FREE_MEMORY = 64 * 1024 * 1024;
+
+// an interpreter on a python thread of its own, driven the way pyhost drives it
+// only one can be alive at a time, the port's state is global
+struct python_session {
+    std::string_view search_paths[1];
+    python_handler handler;
+    std::string script_path;
+
+    explicit python_session(const heap_config& memory, std::string_view search_path = "/tmp")
+        : search_paths{search_path}
+        , handler(search_paths, {}, memory)
+    {
+        // wait for the interpreter to be set up
+        drain();
+        char path[] = "/tmp/python_testXXXXXX.py";
+        const int fd = mkstemps(path, 3);
+        if(fd >= 0)
+        {
+            close(fd);
+            script_path = path;
+        }
+    }
+    ~python_session()
+    {
+        if(!script_path.empty())
+            unlink(script_path.c_str());
+    }
+
+    // everything printed until the handler is done with the current line
+    std::string drain()
+    {
+        std::string out;
+        std::string_view current_read;
+        int status;
+        while((status = handler.read(current_read)) != 0)
+        {
+            if(status == 1)
+            {
+                out += current_read;
+                handler.consume(current_read.size());
+            }
+            else
+            {
+                ctr::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+        return out;
+    }
+
+    // source runs as a file, see python_handler::loop_func; drain() collects what it prints
+    void start(const std::string& source)
+    {
+        if(FILE* f = fopen(script_path.c_str(), "w"))
+        {
+            fwrite(source.data(), 1, source.size(), f);
+            fclose(f);
+        }
+        handler.write(std::string(1, '\0') + script_path);
+    }
+    std::string run(const std::string& source)
+    {
+        start(source);
+        return drain();
+    }
+};
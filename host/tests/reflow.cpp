@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "headless_backend.h"
+#include "screen.h"
+
+// reflow leaves row_head at 0, so right after a scale change row y lives at cells row y
+static u8 fg_at(const screen& scr, std::size_t y, std::size_t x)
+{
+    return scr.cells.fg[y * scr.cells.width + x];
+}
+
+// what a cached row slot shows, left to right, and the color of each glyph
+static std::u32string slot_text(const headless_backend& backend, std::size_t slot, std::vector<u32>& colors)
+{
+    auto glyphs = backend.row_commands(slot);
+    std::erase_if(glyphs, [](const auto& c) { return c.type != headless_backend::command::kind::glyph; });
+    std::sort(glyphs.begin(), glyphs.end(), [](const auto& a, const auto& b) { return a.x < b.x; });
+    std::u32string text;
+    colors.clear();
+    for(const auto& c : glyphs)
+    {
+        text += c.codepoint;
+        colors.push_back(c.color);
+    }
+    return text;
+}
+
+int main()
+{
+    // a 120 column line in two colors, then one more line: 53 columns at scale 0.75, 80 at 0.5
+    {
+        headless_backend backend;
+        screen scr(backend);
+        CHECK(scr.columns() == 53);
+        const std::string red(60, 'r'), green(60, 'g');
+        scr.print("\e[31m" + red + "\e[32m" + green + "\e[0m\r\nnext");
+        const u8 red_fg = fg_at(scr, 0, 0), green_fg = fg_at(scr, 2, 0);
+        CHECK(red_fg != green_fg);
+        CHECK(scr.row_elems[0].wrapped && scr.row_elems[1].wrapped && !scr.row_elems[2].wrapped);
+
+        scr.set_text_scale(0.5f);
+        CHECK(scr.columns() == 80);
+        CHECK(scr.row_elems[0].value == std::u32string(60, U'r') + std::u32string(20, U'g'));
+        CHECK(scr.row_elems[0].wrapped);
+        CHECK(scr.row_elems[1].value == std::u32string(40, U'g'));
+        CHECK(!scr.row_elems[1].wrapped);
+        CHECK(scr.row_elems[2].value == U"next");
+        CHECK(fg_at(scr, 0, 59) == red_fg && fg_at(scr, 0, 60) == green_fg && fg_at(scr, 1, 39) == green_fg);
+        CHECK(scr.cursor_x == 4 && scr.cursor_y == 2);
+
+        // and back: the same rows as printing at 53 columns gave
+        scr.set_text_scale(0.75f);
+        CHECK(scr.row_elems[0].value == std::u32string(53, U'r'));
+        CHECK(scr.row_elems[1].value == std::u32string(7, U'r') + std::u32string(46, U'g'));
+        CHECK(scr.row_elems[2].value == std::u32string(14, U'g'));
+        CHECK(scr.row_elems[3].value == U"next");
+        CHECK(scr.cursor_x == 4 && scr.cursor_y == 3);
+    }
+
+    // hard newlines stay where they were, the cursor stays on its character
+    {
+        headless_backend backend;
+        screen scr(backend);
+        scr.print("abc\r\ndef\r\n" + std::string(70, 'x') + "\e[10D");
+        scr.set_text_scale(0.5f);
+        CHECK(scr.row_elems[0].value == U"abc" && scr.row_elems[1].value == U"def");
+        CHECK(scr.row_elems[2].value == std::u32string(70, U'x'));
+        CHECK(scr.cursor_y == 2 && scr.cursor_x == 60);
+    }
+
+    // a line the scrollback cut is rewrapped with it: paged back to, it reads the same as on screen
+    {
+        headless_backend backend;
+        screen scr(backend);
+        const std::string red(60, 'r'), green(60, 'g');
+        scr.print("\e[31m" + red + "\e[32m" + green + "\e[0m\r\n" + std::string(scr.rows() * 2, '\n'));
+        std::vector<u32> colors;
+        const auto oldest_rows = [&](std::size_t count) {
+            scr.scroll_back(scr.scrollback_size());
+            scr.tick();
+            scr.draw();
+            std::vector<std::u32string> shown;
+            std::vector<u32> first_colors;
+            for(std::size_t i = 0; i < count; ++i)
+            {
+                shown.push_back(slot_text(backend, scr.rows() + i, colors));
+                if(i == 0)
+                    first_colors = colors;
+            }
+            colors = first_colors;
+            scr.reset_view();
+            return shown;
+        };
+
+        scr.set_text_scale(0.5f);
+        auto shown = oldest_rows(3);
+        CHECK(shown[0] == std::u32string(60, U'r') + std::u32string(20, U'g'));
+        CHECK(shown[1] == std::u32string(40, U'g'));
+        CHECK(shown[2].empty());
+        CHECK(colors.size() == 80 && colors[59] != colors[60]);
+
+        scr.set_text_scale(0.75f);
+        shown = oldest_rows(4);
+        CHECK(shown[0] == std::u32string(53, U'r'));
+        CHECK(shown[1] == std::u32string(7, U'r') + std::u32string(46, U'g'));
+        CHECK(shown[2] == std::u32string(14, U'g'));
+        CHECK(shown[3].empty());
+    }
+
+    // so is a line that's half in the scrollback, half on screen: it comes back out whole
+    {
+        headless_backend backend;
+        screen scr(backend);
+        // the line's first row scrolls off, the other two end up at the top
+        scr.print(std::string(scr.rows() - 1, '\n') + std::string(120, 'z') + std::string(scr.rows() - 2, '\n'));
+        const std::size_t kept = scr.scrollback_size();
+        scr.set_text_scale(0.5f);
+        CHECK(scr.scrollback_size() == kept - 1);
+        CHECK(scr.row_elems[0].value == std::u32string(80, U'z') && scr.row_elems[0].wrapped);
+        CHECK(scr.row_elems[1].value == std::u32string(40, U'z') && !scr.row_elems[1].wrapped);
+        CHECK(scr.cursor_y == 20 && scr.cursor_x == 0);
+    }
+
+    // fewer rows at the same width: rows move, nothing is rewrapped or laid out again
+    {
+        headless_backend backend;
+        screen scr(backend);
+        for(int i = 0; i < 15; ++i)
+            scr.print("line " + std::to_string(i) + "\r\n");
+        scr.tick();
+        const u64 laid_out = scr.stats().rows_laid_out;
+        scr.set_output_buffer_size(400, 120);
+        CHECK(scr.columns() == 53 && scr.rows() == 10);
+        CHECK(scr.scrollback_size() == 6);
+        CHECK(scr.cursor_y == 9 && scr.row_elems[8].value == U"line 14");
+        scr.tick();
+        CHECK(scr.stats().rows_laid_out == laid_out);
+    }
+
+    // a tab near the last column stops there, with and without autowrap
+    for(const bool wrap : {true, false})
+    {
+        headless_backend backend;
+        screen scr(backend);
+        scr.print(wrap ? "\e[?7h" : "\e[?7l");
+        scr.print(std::string(scr.columns() - 3, 'x') + "\t");
+        CHECK(scr.cursor_y == 0);
+        CHECK(scr.cursor_x == scr.columns() - 1);
+        CHECK(scr.scroll_x == 0);
+    }
+
+    // an output too small for a single glyph still has one cell to print into
+    {
+        headless_backend backend;
+        screen scr(backend);
+        scr.print("hello\r\nworld");
+        scr.set_output_buffer_size(0, 0);
+        CHECK(scr.columns() == 1 && scr.rows() == 1);
+        scr.print("\tabc\r\n\e[5;5H\e[2J\e[Kxyz");
+        scr.tick();
+        scr.draw();
+        CHECK(scr.cursor_x == 0 && scr.cursor_y == 0);
+        scr.set_output_buffer_size(400, 240);
+        CHECK(scr.columns() == 53);
+    }
+
+    // reflow cost: the scrollback is rewrapped along with the screen, so this grows with it
+    const auto reflow_ms = [](std::size_t history_lines) {
+        headless_backend backend;
+        screen scr(backend);
+        const std::string line(100, 'y');
+        for(std::size_t i = 0; i < history_lines; ++i)
+            scr.print("\e[3" + std::to_string(i % 8) + "m" + line + "\r\n");
+        constexpr int CHANGES = 20;
+        const double seconds = time_s([&]() {
+            for(int i = 0; i < CHANGES; ++i)
+                scr.set_text_scale(i % 2 ? 0.75f : 0.5f);
+        });
+        // every line is 2 rows at either width, and each of them is still there
+        std::vector<u32> colors;
+        if(history_lines)
+        {
+            scr.scroll_back(2);
+            scr.tick();
+            scr.draw();
+            CHECK(slot_text(backend, scr.rows(), colors) + slot_text(backend, scr.rows() + 1, colors) == std::u32string(100, U'y'));
+        }
+        CHECK(scr.row_elems[scr.cursor_y].value.empty());
+        return seconds * 1000 / CHANGES;
+    };
+    const double empty_ms = reflow_ms(0), full_ms = reflow_ms(screen::DEFAULT_SCROLLBACK_DEPTH / 2);
+    printf("reflow: %.3f ms per text scale change with an empty scrollback, %.3f ms with it full of %zu wrapped lines\n",
+        empty_ms, full_ms, screen::DEFAULT_SCROLLBACK_DEPTH / 2);
+    return check_result("reflow");
+}
@@ -0,0 +1,86 @@
+#include <string>
+
+#include "check.h"
+#include "headless_backend.h"
+#include "screen.h"
+
+using kind = headless_backend::command::kind;
+
+// a frame the way application::run draws it, returns the rows rebuilt for it
+static std::size_t frame(screen& scr, headless_backend& backend)
+{
+    const std::size_t before = backend.row_builds();
+    backend.clear_commands();
+    scr.tick();
+    scr.draw();
+    return backend.row_builds() - before;
+}
+
+int main()
+{
+    headless_backend backend;
+    screen scr(backend);
+    const std::size_t ROWS = scr.rows();
+
+    for(std::size_t i = 0; i < ROWS - 1; ++i)
+        scr.print("\e[3" + std::to_string(i % 8) + "mline " + std::to_string(i) + "\e[0m\r\n");
+    CHECK(frame(scr, backend) == ROWS);
+    // rows start out opaque, the text in them isn't blended a second time when they're shown
+    CHECK(backend.row_clear_color() == screen::CLEAR_COLOR);
+
+    // nothing printed: every row comes from its cache, and the frame is the rows and the blinking cursor
+    for(int i = 0; i < 100; ++i)
+    {
+        CHECK(frame(scr, backend) == 0);
+        CHECK(backend.count(kind::row) == ROWS);
+        CHECK(backend.count(kind::glyph) == 0);
+        CHECK(backend.commands().size() == ROWS + scr.cursor_visible);
+    }
+
+    // a prompt being typed into rebuilds the cursor's row only
+    scr.print(">>> ");
+    CHECK(frame(scr, backend) == 1);
+    scr.print("p");
+    CHECK(frame(scr, backend) == 1);
+    // moving the cursor doesn't touch a row
+    scr.print("\e[D\e[C");
+    CHECK(frame(scr, backend) == 0);
+
+    // a new line at the bottom scrolls the ring: the row typed into and the blank one that came in get built
+    scr.print("rint(1)\r\n");
+    CHECK(frame(scr, backend) == 2);
+    CHECK(frame(scr, backend) == 0);
+
+    // looking back builds the history rows shown, the live rows keep their slots below them;
+    // coming back to the live screen rebuilds nothing
+    scr.print(std::string(ROWS * 2, '\n'));
+    frame(scr, backend);
+    scr.scroll_back(3);
+    CHECK(frame(scr, backend) == 3);
+    CHECK(frame(scr, backend) == 0);
+    scr.reset_view();
+    CHECK(frame(scr, backend) == 0);
+
+    // what a cached frame saves: the draw calls of rebuilding every row against those of showing them
+    constexpr int FRAMES = 1000;
+    const double steady = time_s([&]() {
+        for(int i = 0; i < FRAMES; ++i)
+            frame(scr, backend);
+    });
+    const std::size_t steady_calls = backend.commands().size();
+    const double dirty = time_s([&]() {
+        for(int i = 0; i < FRAMES; ++i)
+        {
+            scr.print("\e[H\e[2J");
+            for(std::size_t y = 0; y < ROWS; ++y)
+                scr.print("\e[" + std::to_string(y + 1) + ";1Hredrawn row " + std::to_string(y));
+            CHECK(frame(scr, backend) == ROWS);
+        }
+    });
+    std::size_t full_calls = 0;
+    for(std::size_t slot = 0; slot < ROWS; ++slot)
+        full_calls += backend.row_commands(slot).size();
+    printf("row_cache: %zu draw calls for an unchanged frame in %.1f us, %zu with all rows rebuilt in %.1f us\n",
+        steady_calls, steady / FRAMES * 1e6, full_calls + steady_calls, dirty / FRAMES * 1e6);
+    return check_result("row_cache");
+}
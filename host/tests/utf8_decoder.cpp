@@ -0,0 +1,144 @@
+#include <random>
+#include <string>
+
+#include "check.h"
+#include "utf8_decoder.h"
+#include "screen.h"
+#include "headless_backend.h"
+
+static std::u32string decode_all(std::string_view in)
+{
+    utf8_decoder d;
+    std::u32string out;
+    d.decode(in, out);
+    d.interrupt(out);
+    return out;
+}
+
+// valid text of every length class, with malformed bytes mixed in now and then
+static std::string random_bytes(std::mt19937& rng, std::size_t tokens, std::u32string* valid)
+{
+    const auto pick = [&](unsigned n) { return unsigned(rng() % n); };
+    std::string s;
+    char buf[4];
+    for(std::size_t i = 0; i < tokens; ++i)
+    {
+        char32_t c;
+        switch(pick(6))
+        {
+        case 0:
+            c = 0x20 + pick(0x5f);
+            break;
+        case 1:
+            c = 0x80 + pick(0x800 - 0x80);
+            break;
+        case 2:
+            c = 0x800 + pick(0xd800 - 0x800);
+            break;
+        case 3:
+            c = 0x10000 + pick(0x110000 - 0x10000);
+            break;
+        case 4:
+            c = 0xe000 + pick(0x10000 - 0xe000);
+            break;
+        default:
+            if(!valid)
+            {
+                // a stray continuation, an invalid lead or a sequence cut short by the next one
+                static const char* const bad[] = {"\x80", "\xbf", "\xff", "\xf8", "\xe2\x98", "\xf0\x9f\x90", "\xc3"};
+                s += bad[pick(7)];
+                continue;
+            }
+            c = 'a' + pick(26);
+            break;
+        }
+        s.append(buf, utf8_decoder::encode(c, buf));
+        if(valid)
+            valid->push_back(c);
+    }
+    return s;
+}
+
+int main()
+{
+    // malformed input: one replacement per offending sequence, and what follows it is kept
+    CHECK(decode_all("a\x80z") == U"a�z");
+    CHECK(decode_all("\xc3z") == U"�z");
+    CHECK(decode_all("\xe2\x98") == U"�");
+    CHECK(decode_all("\xc0\xaf") == U"�");
+    CHECK(decode_all("\xe0\x80\xaf") == U"�");
+    CHECK(decode_all("\xed\xa0\x80") == U"�");
+    CHECK(decode_all("\xf4\x90\x80\x80") == U"�");
+    CHECK(decode_all("\xff\xfe") == U"��");
+    CHECK(decode_all("\xf0\x9f\x90\x8d") == U"\U0001f40d");
+    char buf[4];
+    CHECK(utf8_decoder::encode(0xd800, buf) == 0);
+    CHECK(utf8_decoder::encode(0x110000, buf) == 0);
+
+    std::mt19937 rng(7);
+    // valid text comes back as the codepoints that were encoded
+    for(int round = 0; round < 500; ++round)
+    {
+        std::u32string want;
+        const std::string bytes = random_bytes(rng, 100, &want);
+        CHECK(decode_all(bytes) == want);
+    }
+
+    // any number of cuts in a stream decode the same as the whole of it
+    for(int round = 0; round < 2000; ++round)
+    {
+        const std::string bytes = random_bytes(rng, 60, nullptr);
+        const std::u32string whole = decode_all(bytes);
+
+        utf8_decoder d;
+        std::u32string split;
+        std::string_view rest(bytes);
+        const bool bytewise = round % 10 == 0;
+        while(!rest.empty())
+        {
+            const std::size_t n = bytewise ? 1 : std::min<std::size_t>(rest.size(), 1 + rng() % 7);
+            d.decode(rest.substr(0, n), split);
+            rest.remove_prefix(n);
+        }
+        d.interrupt(split);
+        CHECK(split == whole);
+        CHECK(!d.pending());
+        if(split != whole)
+            break;
+    }
+
+    // the screen stores one cell per codepoint, however print() got the bytes
+    {
+        headless_backend backend;
+        screen scr(backend);
+        for(const char c : std::string_view("\xc3\xa9t\xc3\xa9 \xe2\x98\x83"))
+            scr.print(std::string_view(&c, 1));
+        CHECK(scr.cursor_x == 5);
+        CHECK(scr.row_elems[0].value == U"été ☃");
+    }
+
+    // throughput in 4096 byte slices, the way read_output hands output over
+    const auto measure = [](const std::string& corpus) {
+        utf8_decoder d;
+        std::u32string out;
+        out.reserve(4096);
+        std::size_t codepoints = 0;
+        const double seconds = time_s([&]() {
+            for(std::size_t pos = 0; pos < corpus.size(); pos += 4096)
+            {
+                out.clear();
+                d.decode(std::string_view(corpus).substr(pos, 4096), out);
+                codepoints += out.size();
+            }
+        });
+        CHECK(codepoints > 0);
+        return corpus.size() / seconds / 1e6;
+    };
+    std::string ascii, mixed;
+    while(ascii.size() < (16 << 20))
+        ascii += "the quick brown fox jumps over the lazy dog 0123456789\n";
+    while(mixed.size() < (16 << 20))
+        mixed += random_bytes(rng, 1000, nullptr);
+    printf("utf8_decoder: %.1f MB/s on ASCII, %.1f MB/s on mixed text\n", measure(ascii), measure(mixed));
+    return check_result("utf8_decoder");
+}
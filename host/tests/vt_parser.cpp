@@ -0,0 +1,174 @@
+#include <random>
+#include <string>
+
+#include "check.h"
+#include "vt_parser.h"
+
+// everything the parser reported, with print runs merged since where they're cut depends on the feed
+struct recorder {
+    std::string log;
+    bool in_text{false};
+
+    void on_print(std::string_view run)
+    {
+        if(!in_text)
+            log += "P:";
+        log += run;
+        in_text = true;
+    }
+    void on_execute(char c)
+    {
+        event("X", std::string(1, c));
+    }
+    void on_esc(const vt_parser& seq, char final)
+    {
+        event("E", std::string(seq.collected()) + final);
+    }
+    void on_csi(const vt_parser& seq, char final)
+    {
+        std::string s(seq.collected());
+        for(std::size_t i = 0; i < seq.param_total(); ++i)
+            s += std::to_string(seq.param(i, 0)) + ",";
+        event("C", s + final);
+    }
+    void event(const char* kind, const std::string& what)
+    {
+        log += "\n";
+        log += kind;
+        log += what;
+        log += "\n";
+        in_text = false;
+    }
+};
+
+struct counter {
+    std::size_t events{0};
+    void on_print(std::string_view)
+    {
+        ++events;
+    }
+    void on_execute(char)
+    {
+        ++events;
+    }
+    void on_esc(const vt_parser&, char)
+    {
+        ++events;
+    }
+    void on_csi(const vt_parser&, char)
+    {
+        ++events;
+    }
+};
+
+static std::string random_stream(std::mt19937& rng, std::size_t tokens)
+{
+    const auto pick = [&](unsigned n) { return unsigned(rng() % n); };
+    std::string s;
+    for(std::size_t i = 0; i < tokens; ++i)
+    {
+        switch(pick(9))
+        {
+        case 0:
+        case 1:
+            for(unsigned n = 1 + pick(20); n; --n)
+                s += char('a' + pick(26));
+            break;
+        case 2:
+            s += "\xc3\xa9\xe2\x98\x83\xf0\x9f\x90\x8d";
+            break;
+        case 3:
+            s += "\e[";
+            if(pick(4) == 0)
+                s += '?';
+            for(unsigned n = pick(22); n; --n)
+            {
+                s += std::to_string(pick(3) == 0 ? rng() : pick(300));
+                s += pick(8) == 0 ? ':' : ';';
+            }
+            s += "mHJKABCDGdhl"[pick(12)];
+            break;
+        case 4:
+            s += "\e";
+            if(pick(3) == 0)
+                s += '(';
+            s += "78DEMcB"[pick(7)];
+            break;
+        case 5:
+            s += "\e]0;window title\a";
+            break;
+        case 6:
+            s += "\r\n\t\b\a"[pick(5)];
+            break;
+        case 7:
+            // aborted halfway
+            s += "\e[12;3";
+            s += pick(2) ? '\x18' : '\x1a';
+            break;
+        case 8:
+            s += "\x7f";
+            break;
+        }
+    }
+    return s;
+}
+
+int main()
+{
+    // one pass over the whole stream and any number of cuts in it have to report the same
+    std::mt19937 rng(5);
+    for(int round = 0; round < 2000; ++round)
+    {
+        const std::string stream = random_stream(rng, 40);
+        vt_parser whole_parser;
+        recorder whole;
+        whole_parser.feed(stream, whole);
+
+        vt_parser split_parser;
+        recorder split;
+        std::string_view rest(stream);
+        const bool bytewise = round % 10 == 0;
+        while(!rest.empty())
+        {
+            const std::size_t n = bytewise ? 1 : std::min<std::size_t>(rest.size(), 1 + rng() % 16);
+            split_parser.feed(rest.substr(0, n), split);
+            rest.remove_prefix(n);
+        }
+        CHECK(split.log == whole.log);
+        CHECK(split_parser.current_state() == whole_parser.current_state());
+        if(split.log != whole.log)
+            break;
+    }
+
+    // parameters past the last slot are dropped, values clamped
+    {
+        std::string seq = "\e[";
+        for(int i = 1; i <= 20; ++i)
+            seq += std::to_string(i) + ";";
+        seq += "99999999m";
+        vt_parser p;
+        recorder r;
+        p.feed(seq, r);
+        std::string want = "\nC";
+        for(std::size_t i = 1; i <= vt_parser::MAX_PARAMS; ++i)
+            want += std::to_string(i) + ",";
+        CHECK(r.log == want + "m\n");
+
+        recorder clamped;
+        p.feed("\e[99999999;7H", clamped);
+        CHECK(clamped.log == "\nC" + std::to_string(vt_parser::MAX_PARAM_VALUE) + ",7,H\n");
+    }
+
+    // throughput on the same kind of mixed stream, cut the way handle_print cuts it
+    std::string corpus;
+    while(corpus.size() < (8 << 20))
+        corpus += random_stream(rng, 1000);
+    vt_parser p;
+    counter c;
+    const double seconds = time_s([&]() {
+        for(std::size_t pos = 0; pos < corpus.size(); pos += 4096)
+            p.feed(std::string_view(corpus).substr(pos, 4096), c);
+    });
+    printf("vt_parser: %.1f MB/s on a mixed stream, %zu events\n", corpus.size() / seconds / 1e6, c.events);
+    return check_result("vt_parser");
+}
@@ -0,0 +1,257 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "ctr_host.h"
+
+u64 svcGetSystemTick(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void svcSleepThread(s64 ns) {
+    struct timespec ts = { ns / 1000000000LL, ns % 1000000000LL };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+        ;
+    }
+}
+
+void svcBreak(int reason) {
+    fprintf(stderr, "svcBreak(%d)\n", reason);
+    abort();
+}
+
+// absolute CLOCK_MONOTONIC deadline, condition variables get initialized to wait on that clock
+static struct timespec deadline_after(s64 timeout_ns) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (timeout_ns < 0) {
+        timeout_ns = 0;
+    }
+    ts.tv_sec += timeout_ns / 1000000000LL;
+    ts.tv_nsec += timeout_ns % 1000000000LL;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static void monotonic_cond_init(pthread_cond_t *cv) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cv, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+void LightLock_Init(LightLock *lock) {
+    pthread_mutex_init(lock, NULL);
+}
+
+void LightLock_Lock(LightLock *lock) {
+    pthread_mutex_lock(lock);
+}
+
+int LightLock_TryLock(LightLock *lock) {
+    return pthread_mutex_trylock(lock) == 0 ? 0 : 1;
+}
+
+void LightLock_Unlock(LightLock *lock) {
+    pthread_mutex_unlock(lock);
+}
+
+void RecursiveLock_Init(RecursiveLock *lock) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void RecursiveLock_Lock(RecursiveLock *lock) {
+    pthread_mutex_lock(lock);
+}
+
+int RecursiveLock_TryLock(RecursiveLock *lock) {
+    return pthread_mutex_trylock(lock) == 0 ? 0 : 1;
+}
+
+void RecursiveLock_Unlock(RecursiveLock *lock) {
+    pthread_mutex_unlock(lock);
+}
+
+void CondVar_Init(CondVar *cv) {
+    monotonic_cond_init(cv);
+}
+
+void CondVar_Wait(CondVar *cv, LightLock *lock) {
+    pthread_cond_wait(cv, lock);
+}
+
+int CondVar_WaitTimeout(CondVar *cv, LightLock *lock, s64 timeout_ns) {
+    const struct timespec deadline = deadline_after(timeout_ns);
+    return pthread_cond_timedwait(cv, lock, &deadline) == ETIMEDOUT ? 1 : 0;
+}
+
+void CondVar_Signal(CondVar *cv) {
+    pthread_cond_signal(cv);
+}
+
+void CondVar_Broadcast(CondVar *cv) {
+    pthread_cond_broadcast(cv);
+}
+
+void LightEvent_Init(LightEvent *event, ResetType reset_type) {
+    pthread_mutex_init(&event->lock, NULL);
+    monotonic_cond_init(&event->cv);
+    event->signaled = false;
+    event->reset_type = reset_type;
+}
+
+void LightEvent_Clear(LightEvent *event) {
+    pthread_mutex_lock(&event->lock);
+    event->signaled = false;
+    pthread_mutex_unlock(&event->lock);
+}
+
+void LightEvent_Signal(LightEvent *event) {
+    pthread_mutex_lock(&event->lock);
+    if (event->reset_type == RESET_PULSE) {
+        // wakes whoever is waiting right now and stays unsignaled
+        pthread_cond_broadcast(&event->cv);
+    } else {
+        event->signaled = true;
+        if (event->reset_type == RESET_ONESHOT) {
+            pthread_cond_signal(&event->cv);
+        } else {
+            pthread_cond_broadcast(&event->cv);
+        }
+    }
+    pthread_mutex_unlock(&event->lock);
+}
+
+// called with the lock held
+static int event_take(LightEvent *event) {
+    if (!event->signaled) {
+        return 0;
+    }
+    if (event->reset_type == RESET_ONESHOT) {
+        event->signaled = false;
+    }
+    return 1;
+}
+
+int LightEvent_TryWait(LightEvent *event) {
+    pthread_mutex_lock(&event->lock);
+    const int taken = event_take(event);
+    pthread_mutex_unlock(&event->lock);
+    return taken;
+}
+
+void LightEvent_Wait(LightEvent *event) {
+    pthread_mutex_lock(&event->lock);
+    if (event->reset_type == RESET_PULSE) {
+        pthread_cond_wait(&event->cv, &event->lock);
+    } else {
+        while (!event_take(event)) {
+            pthread_cond_wait(&event->cv, &event->lock);
+        }
+    }
+    pthread_mutex_unlock(&event->lock);
+}
+
+int LightEvent_WaitTimeout(LightEvent *event, s64 timeout_ns) {
+    const struct timespec deadline = deadline_after(timeout_ns);
+    int timed_out = 0;
+    pthread_mutex_lock(&event->lock);
+    if (event->reset_type == RESET_PULSE) {
+        timed_out = pthread_cond_timedwait(&event->cv, &event->lock, &deadline) == ETIMEDOUT;
+    } else {
+        while (!event_take(event)) {
+            if (pthread_cond_timedwait(&event->cv, &event->lock, &deadline) == ETIMEDOUT) {
+                timed_out = !event_take(event);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&event->lock);
+    return timed_out;
+}
+
+struct ctr_host_thread {
+    pthread_t handle;
+    ThreadFunc entry;
+    void *arg;
+    bool detached;
+    // threadJoin takes a timeout, pthread_join doesn't: the thread reports finishing through this
+    LightEvent finished;
+};
+
+static _Thread_local Thread current_thread = NULL;
+
+static void *thread_trampoline(void *arg) {
+    Thread thread = arg;
+    current_thread = thread;
+    thread->entry(thread->arg);
+    LightEvent_Signal(&thread->finished);
+    if (thread->detached) {
+        free(thread);
+    }
+    return NULL;
+}
+
+Thread threadCreate(ThreadFunc entry, void *arg, size_t stack_size, int prio, int core_id, bool detached) {
+    Thread thread = malloc(sizeof(*thread));
+    if (thread == NULL) {
+        return NULL;
+    }
+    thread->entry = entry;
+    thread->arg = arg;
+    thread->detached = detached;
+    LightEvent_Init(&thread->finished, RESET_STICKY);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (stack_size < PTHREAD_STACK_MIN) {
+        stack_size = PTHREAD_STACK_MIN;
+    }
+    pthread_attr_setstacksize(&attr, stack_size);
+    if (detached) {
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    }
+    const int err = pthread_create(&thread->handle, &attr, thread_trampoline, thread);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+Thread threadGetCurrent(void) {
+    return current_thread;
+}
+
+Result threadJoin(Thread thread, u64 timeout_ns) {
+    if (thread == NULL) {
+        return 0;
+    }
+    if (timeout_ns == U64_MAX) {
+        LightEvent_Wait(&thread->finished);
+    } else if (LightEvent_WaitTimeout(&thread->finished, (s64)timeout_ns)) {
+        return -1;
+    }
+    return 0;
+}
+
+void threadFree(Thread thread) {
+    if (thread == NULL || thread->detached) {
+        return;
+    }
+    pthread_join(thread->handle, NULL);
+    free(thread);
+}
@@ -0,0 +1,92 @@
+#ifndef MICROPY_INCLUDED_CTR_HOST_H
+#define MICROPY_INCLUDED_CTR_HOST_H
+
+// the part of libctru that the port and python_handler use, on top of pthreads,
+// so that the interpreter loop can be built and measured on a Linux host
+// names and semantics follow libctru: TryLock returns 0 on success, timeouts are in nanoseconds
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef s32 Result;
+#define R_SUCCEEDED(res) ((res) >= 0)
+#define R_FAILED(res) ((res) < 0)
+#define U64_MAX UINT64_MAX
+
+// svcGetSystemTick counts nanoseconds here, code that divides by this still gets the right units
+#define SYSCLOCK_ARM11 (1000000000ULL)
+u64 svcGetSystemTick(void);
+void svcSleepThread(s64 ns);
+
+#define USERBREAK_ASSERT (1)
+void svcBreak(int reason);
+
+typedef pthread_mutex_t LightLock;
+void LightLock_Init(LightLock *lock);
+void LightLock_Lock(LightLock *lock);
+int LightLock_TryLock(LightLock *lock);
+void LightLock_Unlock(LightLock *lock);
+
+typedef pthread_mutex_t RecursiveLock;
+void RecursiveLock_Init(RecursiveLock *lock);
+void RecursiveLock_Lock(RecursiveLock *lock);
+int RecursiveLock_TryLock(RecursiveLock *lock);
+void RecursiveLock_Unlock(RecursiveLock *lock);
+
+typedef pthread_cond_t CondVar;
+void CondVar_Init(CondVar *cv);
+void CondVar_Wait(CondVar *cv, LightLock *lock);
+// 0 when signaled, 1 on timeout
+int CondVar_WaitTimeout(CondVar *cv, LightLock *lock, s64 timeout_ns);
+void CondVar_Signal(CondVar *cv);
+void CondVar_Broadcast(CondVar *cv);
+
+typedef enum {
+    RESET_ONESHOT = 0,
+    RESET_STICKY = 1,
+    RESET_PULSE = 2,
+} ResetType;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    bool signaled;
+    ResetType reset_type;
+} LightEvent;
+void LightEvent_Init(LightEvent *event, ResetType reset_type);
+void LightEvent_Clear(LightEvent *event);
+void LightEvent_Signal(LightEvent *event);
+// 1 if the event was signaled, for a oneshot event that also clears it
+int LightEvent_TryWait(LightEvent *event);
+void LightEvent_Wait(LightEvent *event);
+// 0 when signaled, 1 on timeout
+int LightEvent_WaitTimeout(LightEvent *event, s64 timeout_ns);
+
+// prio and core_id are accepted and ignored; NULL is the main thread, like in libctru
+typedef struct ctr_host_thread *Thread;
+typedef void (*ThreadFunc)(void *);
+Thread threadCreate(ThreadFunc entry, void *arg, size_t stack_size, int prio, int core_id, bool detached);
+Thread threadGetCurrent(void);
+Result threadJoin(Thread thread, u64 timeout_ns);
+void threadFree(Thread thread);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MICROPY_INCLUDED_CTR_HOST_H
@@ -0,0 +1,7 @@
+# Modules compiled into the binary as bytecode, with their qstrs interned at build time.
+# They import without touching the SD card or the GC heap; sys.path lists ".frozen" first.
+# Only used with FROZEN=1, see the top Makefile: it freezes the library that otherwise goes to
+# sdmc:/python-lib, from the directory given in FROZEN_LIB.
+import os
+
+freeze(os.environ["FROZEN_LIB"])
@@ -0,0 +1,64 @@
+#include "py/runtime.h"
+#include "py/objlist.h"
+#include "port_heap.h"
+
+// gcstats.stats() -> dict of what gc_collect measured so far
+static mp_obj_t gcstats_stats(void) {
+    mp_port_gc_stats_t s;
+    mp_port_gc_stats_get(&s);
+
+    // (upper bound in us, count), the last bound being unbounded
+    mp_obj_t histogram = mp_obj_new_list(0, NULL);
+    for (size_t i = 0; i < MP_PORT_GC_PAUSE_BUCKETS; ++i) {
+        mp_obj_t pair[2] = {
+            mp_obj_new_int_from_uint(mp_port_gc_pause_bucket_us[i]),
+            mp_obj_new_int_from_uint(s.pause_histogram[i]),
+        };
+        mp_obj_list_append(histogram, mp_obj_new_tuple(2, pair));
+    }
+
+    mp_obj_t dict = mp_obj_new_dict(11);
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_collections), mp_obj_new_int_from_uint(s.collections));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_pause_total_us), mp_obj_new_int_from_ull(s.pause_total_us));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_pause_last_us), mp_obj_new_int_from_uint(s.pause_last_us));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_pause_max_us), mp_obj_new_int_from_uint(s.pause_max_us));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_freed_total), mp_obj_new_int_from_ull(s.freed_total));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_freed_last), mp_obj_new_int_from_uint(s.freed_last));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_largest_free_block), mp_obj_new_int_from_uint(s.largest_free_block));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_heap_total), mp_obj_new_int_from_uint(s.heap_total));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_heap_free), mp_obj_new_int_from_uint(s.heap_free));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_heap_max), mp_obj_new_int_from_uint(mp_port_heap_max()));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_pause_histogram), histogram);
+    return dict;
+}
+static MP_DEFINE_CONST_FUN_OBJ_0(gcstats_stats_obj, gcstats_stats);
+
+static mp_obj_t gcstats_reset(void) {
+    mp_port_gc_stats_reset();
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_0(gcstats_reset_obj, gcstats_reset);
+
+// gcstats.heap_walk([enable]) -> whether collections count freed and free memory, see port_heap.h
+static mp_obj_t gcstats_heap_walk(size_t n_args, const mp_obj_t *args) {
+    if (n_args == 1) {
+        mp_port_gc_stats_set_heap_walk(mp_obj_is_true(args[0]));
+    }
+    return mp_obj_new_bool(mp_port_gc_stats_heap_walk());
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(gcstats_heap_walk_obj, 0, 1, gcstats_heap_walk);
+
+static const mp_rom_map_elem_t gcstats_module_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_gcstats) },
+    { MP_ROM_QSTR(MP_QSTR_stats), MP_ROM_PTR(&gcstats_stats_obj) },
+    { MP_ROM_QSTR(MP_QSTR_reset), MP_ROM_PTR(&gcstats_reset_obj) },
+    { MP_ROM_QSTR(MP_QSTR_heap_walk), MP_ROM_PTR(&gcstats_heap_walk_obj) },
+};
+static MP_DEFINE_CONST_DICT(gcstats_module_globals, gcstats_module_globals_table);
+
+const mp_obj_module_t mp_module_gcstats = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t *)&gcstats_module_globals,
+};
+
+MP_REGISTER_MODULE(MP_QSTR_gcstats, mp_module_gcstats);
@@ -0,0 +1,74 @@
+#include "py/runtime.h"
+#include "py/mphal.h"
+#include "py/mpthread.h"
+#include "port_prof.h"
+
+#if MICROPY_PORT_PROFILER
+
+// profiler.start(interval_us=1000, path=None), the folded stacks go to path once stopped
+static mp_obj_t profiler_start(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_interval_us, ARG_path };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_interval_us, MP_ARG_INT, {.u_int = MP_PORT_PROF_DEFAULT_INTERVAL_US} },
+        { MP_QSTR_path, MP_ARG_OBJ, {.u_rom_obj = MP_ROM_NONE} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (args[ARG_interval_us].u_int <= 0) {
+        mp_raise_ValueError(MP_ERROR_TEXT("interval must be positive"));
+    }
+    const char *path = args[ARG_path].u_obj == mp_const_none ? NULL : mp_obj_str_get_str(args[ARG_path].u_obj);
+    const int err = mp_port_prof_start(args[ARG_interval_us].u_int, path);
+    if (err != 0) {
+        mp_raise_OSError(err);
+    }
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(profiler_start_obj, 0, profiler_start);
+
+// profiler.stop() -> dict of what got written
+static mp_obj_t profiler_stop(void) {
+    int err = mp_port_prof_stop();
+    if (err != 0) {
+        mp_raise_OSError(err);
+    }
+    mp_port_prof_stats_t s;
+    // writing the file can take a while, other python threads go on meanwhile
+    MP_THREAD_GIL_EXIT();
+    err = mp_port_prof_wait(&s);
+    MP_THREAD_GIL_ENTER();
+    if (err != 0) {
+        mp_raise_OSError(err);
+    }
+
+    mp_obj_t dict = mp_obj_new_dict(4);
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_samples), mp_obj_new_int_from_uint(s.samples));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_ticks), mp_obj_new_int_from_uint(s.ticks));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_stacks), mp_obj_new_int_from_uint(s.stacks));
+    mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_dropped), mp_obj_new_int_from_uint(s.dropped));
+    return dict;
+}
+static MP_DEFINE_CONST_FUN_OBJ_0(profiler_stop_obj, profiler_stop);
+
+static mp_obj_t profiler_running(void) {
+    return mp_obj_new_bool(mp_port_prof_running());
+}
+static MP_DEFINE_CONST_FUN_OBJ_0(profiler_running_obj, profiler_running);
+
+static const mp_rom_map_elem_t profiler_module_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_profiler) },
+    { MP_ROM_QSTR(MP_QSTR_start), MP_ROM_PTR(&profiler_start_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stop), MP_ROM_PTR(&profiler_stop_obj) },
+    { MP_ROM_QSTR(MP_QSTR_running), MP_ROM_PTR(&profiler_running_obj) },
+};
+static MP_DEFINE_CONST_DICT(profiler_module_globals, profiler_module_globals_table);
+
+const mp_obj_module_t mp_module_profiler = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t *)&profiler_module_globals,
+};
+
+MP_REGISTER_MODULE(MP_QSTR_profiler, mp_module_profiler);
+
+#endif // MICROPY_PORT_PROFILER
@@ -9,12 +9,32 @@
 // will still be able to execute pre-compiled scripts, compiled with mpy-cross.
 #define MICROPY_ENABLE_COMPILER                 (1)
 
-// #define MICROPY_QSTR_EXTRA_POOL                 mp_qstr_frozen_const_pool
 #define MICROPY_ENABLE_GC                       (1)
+// the heap starts as one area and grows by more areas instead of raising MemoryError, see port_heap.h
+#define MICROPY_GC_SPLIT_HEAP                   (1)
+#define MICROPY_GC_SPLIT_HEAP_AUTO              (1)
+#define MP_PLAT_ALLOC_HEAP(size)                mp_port_heap_alloc(size)
 #define MICROPY_HELPER_REPL                     (1)
+// with a FROZEN_MANIFEST, py.mk turns these on and sets MICROPY_QSTR_EXTRA_POOL to the frozen qstrs
+#ifndef MICROPY_MODULE_FROZEN_MPY
 #define MICROPY_MODULE_FROZEN_MPY               (0)
+#endif
+#ifndef MICROPY_MODULE_FROZEN_STR
 #define MICROPY_MODULE_FROZEN_STR               (0)
+#endif
 #define MICROPY_ENABLE_EXTERNAL_IMPORT          (1)
+// imported sources get compiled to .mpy once, see vfs_mpycache.h
+#define MICROPY_PERSISTENT_CODE_LOAD            (1)
+#define MICROPY_PERSISTENT_CODE_SAVE            (1)
+#define MICROPY_PERSISTENT_CODE_SAVE_FILE       (1)
+
+// @micropython.native and @micropython.viper, the code lands in the region from port_exec.h
+#if defined(__arm__)
+#define MICROPY_EMIT_ARM                        (1)
+#elif defined(__x86_64__)
+#define MICROPY_EMIT_X64                        (1)
+#endif
+#define MP_PLAT_COMMIT_EXEC(buf, len, reloc)    mp_port_exec_commit(buf, len, reloc)
 
 #define MICROPY_ALLOC_PATH_MAX                  (256)
 #define MICROPY_ALLOC_PARSE_CHUNK_INIT          (16)
@@ -30,6 +50,16 @@
 #define MICROPY_PY_SYS_STDFILES                 (0)
 #define MICROPY_PY_SYS_PATH_ARGV_DEFAULTS       (0)
 #define MICROPY_PY_SYS_PS1_PS2                  (0)
+// the sampling profiler of port_prof.h walks the code state chain sys.settrace keeps, which costs a check
+// every opcode and a frame object every call, so only builds with PROFILER=1 have it, see the top Makefile
+#ifndef MICROPY_PORT_PROFILER
+#define MICROPY_PORT_PROFILER                   (0)
+#endif
+#define MICROPY_PY_SYS_SETTRACE                 (MICROPY_PORT_PROFILER)
+#if MICROPY_PORT_PROFILER
+// py/mpconfig.h doesn't allow it together with settrace
+#define MICROPY_COMP_CONST                      (0)
+#endif
 
 #define MICROPY_VFS                             (1)
 #define MICROPY_VFS_POSIX                       (1)
@@ -40,7 +70,8 @@
 // #define MICROPY_DEBUG_VERBOSE                   (1)
 
 #define MICROPY_PORT_BUILTINS \
-    { MP_ROM_QSTR(MP_QSTR_input), MP_ROM_PTR(&mp_builtin_input_obj) },
+    { MP_ROM_QSTR(MP_QSTR_input), MP_ROM_PTR(&mp_builtin_input_obj) }, \
+    { MP_ROM_QSTR(MP_QSTR_TimeoutError), MP_ROM_PTR(&mp_type_TimeoutError) },
 
 // type definitions for the specific machine
 typedef intptr_t mp_int_t; // must be pointer size
@@ -50,6 +81,12 @@ typedef long mp_off_t;
 // We need to provide a declaration/definition of alloca()
 #include <alloca.h>
 
+#include "port_heap.h"
+#include "port_exec.h"
+#include "port_event.h"
+#include "port_budget.h"
+#include "port_prof.h"
+
 #define MICROPY_HW_BOARD_NAME "ninty3ds"
 #define MICROPY_HW_MCU_NAME "mpcore"
 
@@ -57,13 +94,21 @@ typedef long mp_off_t;
 
 #include <errno.h>
 
+// waits block on the port event instead of polling, see port_event.h
 #define MICROPY_EVENT_POLL_HOOK \
     do { \
-        extern void mp_handle_pending(bool); \
-        extern void mp_hal_delay_us(mp_uint_t us); \
-        mp_handle_pending(true); \
-        mp_hal_delay_us(250); \
+        mp_port_event_poll(); \
     } while (0);
+#define MICROPY_SCHED_HOOK_SCHEDULED mp_port_event_signal()
+
+// counts toward the VM budget of port_budget.h, and records a profiler sample when one is due
+#define MICROPY_VM_HOOK_LOOP \
+    if (--mp_port_budget_ticks_left == 0) { \
+        mp_port_budget_ticks_ran_out(); \
+    } \
+    if (MICROPY_PORT_PROFILER && mp_port_prof_pending) { \
+        mp_port_prof_sample(); \
+    }
 
 // This macro is used to implement PEP 475 to retry specified syscalls on EINTR
 #define MP_HAL_RETRY_SYSCALL(ret, syscall, raise) \
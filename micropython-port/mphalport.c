@@ -3,10 +3,6 @@
 #include <time.h>
 #include <sys/time.h>
 
-void mp_hal_delay_us(mp_uint_t us) {
-    usleep(us);
-}
-
 mp_uint_t mp_hal_ticks_ms(void) {
 #if (defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0) && defined(_POSIX_MONOTONIC_CLOCK)
     struct timespec tv;
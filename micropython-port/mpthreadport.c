@@ -1,7 +1,11 @@
 #include "mpthreadport.h"
 #include "py/mpstate.h"
 #include "py/runtime.h"
+#ifdef __3DS__
 #include <3ds.h>
+#else
+#include "ctr_host.h"
+#endif
 #include <stdlib.h>
 
 static _Thread_local mp_state_thread_t* thread_current_state = NULL;
@@ -17,6 +21,11 @@ void mp_thread_mutex_init(mp_thread_mutex_t *mutex) {
 }
 
 int mp_thread_mutex_lock(mp_thread_mutex_t *mutex, int wait) {
+    // a waiting lock blocks in the kernel, it doesn't go through the poll hook
+    if (wait) {
+        LightLock_Lock(mutex);
+        return 1;
+    }
     return LightLock_TryLock(mutex) == 0;
 }
 
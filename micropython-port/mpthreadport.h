@@ -1,5 +1,9 @@
 #include <stdint.h>
+#ifdef __3DS__
 #include <3ds/synchronization.h>
+#else
+#include "ctr_host.h"
+#endif
 
 typedef LightLock mp_thread_mutex_t;
 
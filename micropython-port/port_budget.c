@@ -0,0 +1,85 @@
+#include "py/runtime.h"
+#include "py/objexcept.h"
+#include "port_budget.h"
+#include "port_event.h"
+
+// a subclass of OSError, like in CPython
+MP_DEFINE_CONST_OBJ_TYPE(
+    mp_type_TimeoutError,
+    MP_QSTR_TimeoutError,
+    MP_TYPE_FLAG_NONE,
+    make_new, mp_obj_exception_make_new,
+    print, mp_obj_exception_print,
+    attr, mp_obj_exception_attr,
+    parent, &mp_type_OSError
+    );
+
+// made by the python thread before each run, so the monitor thread never allocates; the root pointers keep them
+// and their tracebacks alive
+MP_REGISTER_ROOT_POINTER(mp_obj_t budget_time_exc);
+MP_REGISTER_ROOT_POINTER(mp_obj_t budget_ticks_exc);
+
+// without a limit the counter still wraps around, so the ticks used can be reported
+uint32_t mp_port_budget_ticks_left = UINT32_MAX;
+static uint32_t ticks_armed = UINT32_MAX;
+static uint32_t ticks_budget;
+static uint64_t ticks_wrapped;
+static bool ticks_limited;
+static volatile bool expired;
+
+static void raise_in_python_thread(mp_obj_t exc) {
+    expired = true;
+    // the same object gets raised again each time a budget runs out, without the traceback of the last time
+    mp_obj_exception_clear_traceback(exc);
+    // the same way mp_sched_keyboard_interrupt gets an exception raised
+    MP_STATE_MAIN_THREAD(mp_pending_exception) = exc;
+    #if MICROPY_ENABLE_SCHEDULER
+    if (MP_STATE_VM(sched_state) == MP_SCHED_IDLE) {
+        MP_STATE_VM(sched_state) = MP_SCHED_PENDING;
+    }
+    #endif
+    mp_port_event_signal();
+}
+
+void mp_port_budget_arm(uint32_t vm_ticks) {
+    MP_STATE_PORT(budget_time_exc) = mp_obj_new_exception_msg(&mp_type_TimeoutError, MP_ERROR_TEXT("time budget used up"));
+    MP_STATE_PORT(budget_ticks_exc) = mp_obj_new_exception_msg(&mp_type_TimeoutError, MP_ERROR_TEXT("instruction budget used up"));
+    expired = false;
+    ticks_limited = vm_ticks != 0;
+    ticks_budget = vm_ticks;
+    ticks_armed = ticks_limited ? vm_ticks : UINT32_MAX;
+    ticks_wrapped = 0;
+    mp_port_budget_ticks_left = ticks_armed;
+}
+
+void mp_port_budget_ticks_ran_out(void) {
+    ticks_wrapped += ticks_armed;
+    // like the time limit, code that catches the TimeoutError gets another one a budget later
+    ticks_armed = ticks_limited ? ticks_budget : UINT32_MAX;
+    mp_port_budget_ticks_left = ticks_armed;
+    if (ticks_limited) {
+        raise_in_python_thread(MP_STATE_PORT(budget_ticks_exc));
+    }
+}
+
+uint64_t mp_port_budget_disarm(void) {
+    const uint64_t used = ticks_wrapped + (ticks_armed - mp_port_budget_ticks_left);
+    ticks_limited = false;
+    ticks_armed = UINT32_MAX;
+    mp_port_budget_ticks_left = UINT32_MAX;
+    const mp_obj_t pending = MP_STATE_MAIN_THREAD(mp_pending_exception);
+    if (pending != MP_OBJ_NULL && (pending == MP_STATE_PORT(budget_time_exc) || pending == MP_STATE_PORT(budget_ticks_exc))) {
+        MP_STATE_MAIN_THREAD(mp_pending_exception) = MP_OBJ_NULL;
+    }
+    MP_STATE_PORT(budget_time_exc) = MP_OBJ_NULL;
+    MP_STATE_PORT(budget_ticks_exc) = MP_OBJ_NULL;
+    return used;
+}
+
+void mp_port_budget_expire_time(void) {
+    raise_in_python_thread(MP_STATE_PORT(budget_time_exc));
+}
+
+bool mp_port_budget_expired(void) {
+    return expired;
+}
@@ -0,0 +1,28 @@
+#ifndef MICROPY_INCLUDED_PORT_BUDGET_H
+#define MICROPY_INCLUDED_PORT_BUDGET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// limits on one submission, a REPL line or a script: when one runs out the python thread gets a TimeoutError,
+// which the code can catch; the VM budget counts jumps and calls, the points where bytecode can be interrupted
+// both limits start over when they fire, so code that catches the TimeoutError gets another one a budget later,
+// for as long as the submission runs
+
+// counted down by MICROPY_VM_HOOK_LOOP, in every python thread
+extern uint32_t mp_port_budget_ticks_left;
+void mp_port_budget_ticks_ran_out(void);
+
+// from the python thread, before the submission runs; vm_ticks = 0 doesn't limit them
+void mp_port_budget_arm(uint32_t vm_ticks);
+// from the python thread after it ran, drops a TimeoutError that didn't get raised and returns the VM ticks used
+uint64_t mp_port_budget_disarm(void);
+// from any thread, the python thread raises TimeoutError at its next checkpoint or as soon as a wait ends
+void mp_port_budget_expire_time(void);
+// whether a limit ran out since mp_port_budget_arm
+bool mp_port_budget_expired(void);
+
+struct _mp_obj_type_t;
+extern const struct _mp_obj_type_t mp_type_TimeoutError;
+
+#endif // MICROPY_INCLUDED_PORT_BUDGET_H
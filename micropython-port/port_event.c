@@ -0,0 +1,83 @@
+#ifdef __3DS__
+#include <3ds.h>
+#else
+#include "ctr_host.h"
+#endif
+
+#include <time.h>
+
+#include "py/runtime.h"
+#include "py/mphal.h"
+#include "py/mpthread.h"
+#include "port_event.h"
+
+static LightEvent port_event;
+
+#ifdef __3DS__
+static _Thread_local u64 idle_ticks, idle_since;
+#endif
+
+uint64_t mp_port_cpu_time_us(void) {
+    #ifdef __3DS__
+    return (svcGetSystemTick() - idle_ticks) / (SYSCLOCK_ARM11 / 1000000);
+    #else
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    #endif
+}
+
+void mp_port_idle_begin(void) {
+    #ifdef __3DS__
+    idle_since = svcGetSystemTick();
+    #endif
+}
+
+void mp_port_idle_end(void) {
+    #ifdef __3DS__
+    idle_ticks += svcGetSystemTick() - idle_since;
+    #endif
+}
+
+void mp_port_event_init(void) {
+    LightEvent_Init(&port_event, RESET_ONESHOT);
+}
+
+void mp_port_event_signal(void) {
+    LightEvent_Signal(&port_event);
+}
+
+bool mp_port_event_wait(uint32_t timeout_us) {
+    mp_port_idle_begin();
+    const bool signaled = LightEvent_WaitTimeout(&port_event, (s64)timeout_us * 1000) == 0;
+    mp_port_idle_end();
+    return signaled;
+}
+
+void mp_port_event_poll(void) {
+    mp_handle_pending(true);
+    MP_THREAD_GIL_EXIT();
+    mp_port_event_wait(MP_PORT_EVENT_POLL_MAX_US);
+    MP_THREAD_GIL_ENTER();
+    mp_handle_pending(true);
+}
+
+// both wake up early for an interrupt or a scheduled callback, and run it
+void mp_hal_delay_us(mp_uint_t us) {
+    const u64 ticks_per_us = SYSCLOCK_ARM11 / 1000000;
+    const u64 end = svcGetSystemTick() + (u64)us * ticks_per_us;
+    for (;;) {
+        mp_handle_pending(true);
+        const u64 now = svcGetSystemTick();
+        if (now >= end) {
+            break;
+        }
+        MP_THREAD_GIL_EXIT();
+        mp_port_event_wait((end - now + ticks_per_us - 1) / ticks_per_us);
+        MP_THREAD_GIL_ENTER();
+    }
+}
+
+void mp_hal_delay_ms(mp_uint_t ms) {
+    mp_hal_delay_us(ms * 1000);
+}
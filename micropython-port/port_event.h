@@ -0,0 +1,27 @@
+#ifndef MICROPY_INCLUDED_PORT_EVENT_H
+#define MICROPY_INCLUDED_PORT_EVENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// what an idle interpreter blocks on instead of sleeping in fixed steps:
+// a keyboard interrupt, a scheduled callback or anything else that should wake it signals the event
+// sources that can't signal, like polled streams, are still noticed within MP_PORT_EVENT_POLL_MAX_US
+#define MP_PORT_EVENT_POLL_MAX_US (10000)
+
+// before anything can signal
+void mp_port_event_init(void);
+// safe from any thread, a signal with nobody waiting ends the next wait right away
+void mp_port_event_signal(void);
+// true if signaled before timeout_us went by
+bool mp_port_event_wait(uint32_t timeout_us);
+// time the calling thread spent running rather than blocked, only the difference between two calls means anything;
+// the 3DS has no per-thread CPU clock, there it is the time outside of waits, time lost to other threads included
+uint64_t mp_port_cpu_time_us(void);
+// around a blocking wait that doesn't go through mp_port_event_wait, so it isn't counted as running
+void mp_port_idle_begin(void);
+void mp_port_idle_end(void);
+// MICROPY_EVENT_POLL_HOOK: lets other python threads run while waiting, and raises what woke it up
+void mp_port_event_poll(void);
+
+#endif // MICROPY_INCLUDED_PORT_EVENT_H
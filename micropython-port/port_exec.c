@@ -0,0 +1,116 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "py/runtime.h"
+#include "py/persistentcode.h"
+#include "port_exec.h"
+
+#if defined(__3DS__)
+#include <malloc.h>
+#include <3ds.h>
+#define EXEC_PAGE_SIZE (0x1000)
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static uint8_t *exec_region;
+static size_t exec_region_size;
+static size_t exec_region_used;
+
+#if defined(__3DS__)
+
+// svcControlProcessMemory and the cache operations want a real handle, not the CUR_PROCESS_HANDLE pseudo handle
+static Handle exec_process;
+
+static uint8_t *exec_map(size_t size) {
+    uint8_t *region = memalign(EXEC_PAGE_SIZE, size);
+    if (region == NULL) {
+        return NULL;
+    }
+    Result res = svcDuplicateHandle(&exec_process, CUR_PROCESS_HANDLE);
+    if (R_SUCCEEDED(res)) {
+        res = svcControlProcessMemory(exec_process, (u32)region, 0, size, MEMOP_PROT, MEMPERM_READ | MEMPERM_WRITE | MEMPERM_EXECUTE);
+        if (R_FAILED(res)) {
+            svcCloseHandle(exec_process);
+        }
+    }
+    if (R_FAILED(res)) {
+        fprintf(stderr, "native code: no executable memory (%08lx)\n", (unsigned long)res);
+        free(region);
+        return NULL;
+    }
+    return region;
+}
+
+static void exec_sync(uint8_t *code, size_t len) {
+    // the code was written through the data cache, the instruction cache may still hold what was there before
+    svcFlushProcessDataCache(exec_process, (u32)code, len);
+    svcInvalidateProcessInstructionCache(exec_process, (u32)code, len);
+}
+
+#else
+
+static uint8_t *exec_map(size_t size) {
+    void *region = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        perror("native code: mmap");
+        return NULL;
+    }
+    return region;
+}
+
+static void exec_sync(uint8_t *code, size_t len) {
+    __builtin___clear_cache((char *)code, (char *)code + len);
+}
+
+#endif
+
+bool mp_port_exec_init(size_t size) {
+    if (exec_region != NULL) {
+        return true;
+    }
+    #if defined(__3DS__)
+    const size_t page = EXEC_PAGE_SIZE;
+    #else
+    const size_t page = sysconf(_SC_PAGESIZE);
+    #endif
+    size = (size + page - 1) & ~(page - 1);
+    exec_region = exec_map(size);
+    if (exec_region == NULL) {
+        return false;
+    }
+    exec_region_size = size;
+    exec_region_used = 0;
+    return true;
+}
+
+void *mp_port_exec_commit(void *buf, size_t len, void *reloc) {
+    const size_t aligned = (len + 7) & ~(size_t)7;
+    if (aligned > exec_region_size - exec_region_used) {
+        m_malloc_fail(len);
+    }
+    uint8_t *code = exec_region + exec_region_used;
+    #if MICROPY_PERSISTENT_CODE_LOAD && MICROPY_EMIT_MACHINE_CODE
+    if (reloc) {
+        mp_native_relocate(reloc, buf, (uintptr_t)code);
+    }
+    #endif
+    memcpy(code, buf, len);
+    exec_sync(code, len);
+    exec_region_used += aligned;
+    return code;
+}
+
+size_t mp_port_exec_used(void) {
+    return exec_region_used;
+}
+
+size_t mp_port_exec_size(void) {
+    return exec_region_size;
+}
+
+void mp_port_exec_reset(void) {
+    exec_region_used = 0;
+}
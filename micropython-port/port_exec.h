@@ -0,0 +1,17 @@
+#ifndef MICROPY_INCLUDED_PORT_EXEC_H
+#define MICROPY_INCLUDED_PORT_EXEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// machine code from @micropython.native/viper and native .mpy files is copied into one executable region
+// and never freed on its own, the whole region is reused after mp_deinit
+// returns false when the platform won't hand out executable memory, native code then raises MemoryError
+bool mp_port_exec_init(size_t size);
+void *mp_port_exec_commit(void *buf, size_t len, void *reloc);
+size_t mp_port_exec_used(void);
+size_t mp_port_exec_size(void);
+// after mp_deinit, forgets all committed code but keeps the region
+void mp_port_exec_reset(void);
+
+#endif // MICROPY_INCLUDED_PORT_EXEC_H
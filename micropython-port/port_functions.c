@@ -1,7 +1,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#ifdef __3DS__
 #include <3ds.h>
+#else
+#include "ctr_host.h"
+#endif
 
 #include "py/builtin.h"
 #include "py/compile.h"
@@ -10,8 +14,12 @@
 #include "py/gc.h"
 #include "py/stackctrl.h"
 #include "py/mperrno.h"
+#include "py/mphal.h"
 #include "shared/readline/readline.h"
+#include "shared/runtime/gchelper.h"
+#include "port_heap.h"
 
+#ifdef __3DS__
 static int my_readline(vstr_t *line, const char *prompt) {
     SwkbdState swkbd;
     char* buf = (char*)calloc(1,1024);
@@ -20,7 +28,9 @@ static int my_readline(vstr_t *line, const char *prompt) {
     swkbdSetButton(&swkbd, SWKBD_BUTTON_LEFT, "Int.", true);
     // swkbdSetButton(&swkbd, SWKBD_BUTTON_MIDDLE, "EOF", true);
     swkbdSetButton(&swkbd, SWKBD_BUTTON_RIGHT, "Enter", true);
+    mp_port_idle_begin();
     SwkbdButton res = swkbdInputText(&swkbd, buf, 1024);
+    mp_port_idle_end();
     if(res == SWKBD_BUTTON_LEFT)
     {
         vstr_init(line, 0);
@@ -41,6 +51,22 @@ static int my_readline(vstr_t *line, const char *prompt) {
         return 0;
     }
 }
+#else
+// there is no keyboard applet on the host, input() reads a line from stdin and EOF acts like the EOF button
+static int my_readline(vstr_t *line, const char *prompt) {
+    char buf[1024];
+    mp_hal_stdout_tx_str(prompt);
+    vstr_init(line, 0);
+    if (fgets(buf, sizeof(buf), stdin) == NULL) {
+        return CHAR_CTRL_D;
+    }
+    vstr_add_str(line, buf);
+    if (line->len && line->buf[line->len - 1] == '\n') {
+        vstr_cut_tail_bytes(line, 1);
+    }
+    return 0;
+}
+#endif
 
 static mp_obj_t my_input_builtin(size_t n_args, const mp_obj_t *args, mp_map_t *kwargs) {
     const char* prompt = "";
@@ -60,12 +86,142 @@ static mp_obj_t my_input_builtin(size_t n_args, const mp_obj_t *args, mp_map_t *
 }
 MP_DEFINE_CONST_FUN_OBJ_KW(mp_builtin_input_obj, 1, my_input_builtin);
 
+const uint32_t mp_port_gc_pause_bucket_us[MP_PORT_GC_PAUSE_BUCKETS] = {
+    1000, 2000, 5000, 10000, 20000, 50000, 100000, UINT32_MAX,
+};
+
+// every area the GC heap is made of, see mp_port_heap_alloc
+static size_t heap_total;
+
+// seqlock: odd while gc_stats is being written, readers retry until they see the same even value around their copy
+static uint32_t gc_stats_seq;
+static mp_port_gc_stats_t gc_stats;
+
+static void gc_stats_write_begin(void) {
+    __atomic_store_n(&gc_stats_seq, gc_stats_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void gc_stats_write_end(void) {
+    __atomic_store_n(&gc_stats_seq, gc_stats_seq + 1, __ATOMIC_RELEASE);
+}
+
+void mp_port_gc_stats_get(mp_port_gc_stats_t *out) {
+    uint32_t before, after;
+    do {
+        before = __atomic_load_n(&gc_stats_seq, __ATOMIC_ACQUIRE);
+        memcpy(out, &gc_stats, sizeof(gc_stats));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&gc_stats_seq, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+}
+
+void mp_port_gc_stats_reset(void) {
+    gc_stats_write_begin();
+    memset(&gc_stats, 0, sizeof(gc_stats));
+    gc_stats_write_end();
+}
+
+// off by default: each gc_info walks the whole allocation table, which would make every collection longer
+static volatile bool gc_stats_heap_walk;
+
+void mp_port_gc_stats_set_heap_walk(bool enable) {
+    gc_stats_heap_walk = enable;
+}
+
+bool mp_port_gc_stats_heap_walk(void) {
+    return gc_stats_heap_walk;
+}
+
 void gc_collect(void) {
+    // both outside of the measured pause, but still part of the stall, so only when asked for
+    const bool walk = gc_stats_heap_walk;
+    gc_info_t before, after;
+    if (walk) {
+        gc_info(&before);
+    }
+
+    const uint64_t start = svcGetSystemTick();
     gc_collect_start();
-    const mp_uint_t stack_use = mp_stack_usage();
-    void** sp = (void**)((uintptr_t)MP_STATE_THREAD(stack_top) - stack_use);
-    gc_collect_root(sp, stack_use);
+    // callee-saved registers can hold the only reference to an object, the stack alone isn't enough
+    gc_helper_collect_regs_and_stack();
     gc_collect_end();
+    const uint64_t pause_us = (svcGetSystemTick() - start) * 1000000 / SYSCLOCK_ARM11;
+
+    if (walk) {
+        gc_info(&after);
+    }
+
+    size_t bucket = 0;
+    while (pause_us > mp_port_gc_pause_bucket_us[bucket]) {
+        ++bucket;
+    }
+
+    gc_stats_write_begin();
+    gc_stats.collections += 1;
+    gc_stats.pause_total_us += pause_us;
+    gc_stats.pause_last_us = pause_us;
+    if (pause_us > gc_stats.pause_max_us) {
+        gc_stats.pause_max_us = pause_us;
+    }
+    if (walk) {
+        gc_stats.freed_last = after.free > before.free ? after.free - before.free : 0;
+        gc_stats.freed_total += gc_stats.freed_last;
+        gc_stats.largest_free_block = after.max_free * MICROPY_BYTES_PER_GC_BLOCK;
+        gc_stats.heap_free = after.free;
+    }
+    gc_stats.heap_total = heap_total;
+    gc_stats.pause_histogram[bucket] += 1;
+    gc_stats_write_end();
+}
+
+#define MAX_EXTRA_HEAP_AREAS (32)
+
+static size_t heap_max_total;
+static void *extra_heap_areas[MAX_EXTRA_HEAP_AREAS];
+static size_t extra_heap_count;
+
+void mp_port_heap_init(size_t first_area, size_t max_total) {
+    heap_total = first_area;
+    heap_max_total = max_total > first_area ? max_total : first_area;
+    extra_heap_count = 0;
+}
+
+size_t gc_get_max_new_split(void) {
+    if (extra_heap_count == MAX_EXTRA_HEAP_AREAS) {
+        return 0;
+    }
+    return heap_max_total - heap_total;
+}
+
+void *mp_port_heap_alloc(size_t size) {
+    if (extra_heap_count == MAX_EXTRA_HEAP_AREAS || size > heap_max_total - heap_total) {
+        return NULL;
+    }
+    void *area = malloc(size);
+    if (area == NULL) {
+        fprintf(stderr, "gc heap: could not grow by %u KiB\n", (unsigned)(size / 1024));
+        return NULL;
+    }
+    extra_heap_areas[extra_heap_count++] = area;
+    heap_total += size;
+    fprintf(stderr, "gc heap: grown by %u KiB to %u KiB in %u areas\n",
+        (unsigned)(size / 1024), (unsigned)(heap_total / 1024), (unsigned)(extra_heap_count + 1));
+    return area;
+}
+
+size_t mp_port_heap_total(void) {
+    return heap_total;
+}
+
+size_t mp_port_heap_max(void) {
+    return heap_max_total;
+}
+
+void mp_port_heap_free_all(void) {
+    while (extra_heap_count) {
+        free(extra_heap_areas[--extra_heap_count]);
+    }
 }
 
 void nlr_jump_fail(void *val) {
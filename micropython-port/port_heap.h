@@ -0,0 +1,44 @@
+#ifndef MICROPY_INCLUDED_PORT_HEAP_H
+#define MICROPY_INCLUDED_PORT_HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// the first area is given to gc_init by the embedder, the GC asks for more through MP_PLAT_ALLOC_HEAP
+// when an allocation still fails after a collection, until the whole heap is max_total bytes
+void mp_port_heap_init(size_t first_area, size_t max_total);
+void *mp_port_heap_alloc(size_t size);
+size_t mp_port_heap_total(void);
+size_t mp_port_heap_max(void);
+// after mp_deinit, releases the areas added since mp_port_heap_init
+void mp_port_heap_free_all(void);
+
+// filled in by gc_collect, the histogram counts pauses up to each bucket's bound
+#define MP_PORT_GC_PAUSE_BUCKETS (8)
+extern const uint32_t mp_port_gc_pause_bucket_us[MP_PORT_GC_PAUSE_BUCKETS];
+
+typedef struct _mp_port_gc_stats_t {
+    uint32_t collections;
+    uint64_t pause_total_us;
+    uint32_t pause_last_us;
+    uint32_t pause_max_us;
+    uint64_t freed_total;
+    size_t freed_last;
+    // measured right after the last collection
+    size_t largest_free_block;
+    size_t heap_total;
+    size_t heap_free;
+    // freed_*, largest_free_block and heap_free only move while the heap walk is on
+    uint32_t pause_histogram[MP_PORT_GC_PAUSE_BUCKETS];
+} mp_port_gc_stats_t;
+
+// safe to call from any thread, gives a consistent copy
+void mp_port_gc_stats_get(mp_port_gc_stats_t *out);
+void mp_port_gc_stats_reset(void);
+// the heap walk counts what a collection freed and what's left, but it walks the allocation table before and
+// after each collection, lengthening the stall being measured; off until turned on
+void mp_port_gc_stats_set_heap_walk(bool enable);
+bool mp_port_gc_stats_heap_walk(void);
+
+#endif // MICROPY_INCLUDED_PORT_HEAP_H
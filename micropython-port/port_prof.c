@@ -0,0 +1,415 @@
+#ifdef __3DS__
+#include <3ds.h>
+#else
+#include "ctr_host.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "py/runtime.h"
+#include "py/bc.h"
+#include "py/objfun.h"
+#include "port_prof.h"
+
+volatile uint32_t mp_port_prof_pending;
+
+static LightLock ctl_lock;
+static char *default_path;
+
+#if MICROPY_PORT_PROFILER
+
+// a sample is a header followed by its frames, innermost first: the header has no name,
+// its ticks are what it stands for and its line the depth, with PROF_TRUNCATED set when the chain went on;
+// names are resolved by the python thread as it samples, the writer thread never looks at the qstr tables,
+// which other python code keeps adding to; the strings stay put until the heap goes away
+typedef struct _prof_frame_t {
+    const char *name;
+    union {
+        const char *file;
+        uint32_t ticks;
+    };
+    uint32_t line;
+} prof_frame_t;
+#define PROF_TRUNCATED (0x80000000u)
+#define PROF_DEPTH_MASK (0x7fffffffu)
+#define RING_MASK (MP_PORT_PROF_RING_FRAMES - 1)
+
+// positions only grow and get masked, so head - tail is what the ring holds even after they wrap
+static prof_frame_t *ring;
+static uint32_t ring_head, ring_tail;
+static LightLock ring_lock;
+static volatile uint32_t dropped;
+
+static volatile bool running;
+static char *run_path;
+static Thread timer;
+static LightEvent timer_stop;
+
+// what stop hands to the writer thread, which owns it from then on
+typedef struct _prof_write_t {
+    prof_frame_t *frames;
+    uint32_t head, tail;
+    char *path;
+    uint32_t dropped;
+} prof_write_t;
+static Thread writer;
+// the last write's outcome, until mp_port_prof_wait hands it out
+static mp_port_prof_stats_t write_stats;
+static int write_err;
+static bool write_done;
+
+static void timer_func(void *arg) {
+    const s64 interval_ns = (s64)(uintptr_t)arg * 1000;
+    while (LightEvent_WaitTimeout(&timer_stop, interval_ns) != 0) {
+        // ticks only count while there's bytecode to blame them on, not between REPL lines
+        if (__atomic_load_n(&MP_STATE_MAIN_THREAD(current_code_state), __ATOMIC_RELAXED) != NULL) {
+            __atomic_add_fetch(&mp_port_prof_pending, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void frame_of(const mp_code_state_t *code_state, prof_frame_t *out) {
+    // the same decoding vm.c does to add a traceback entry
+    const byte *ip = code_state->fun_bc->bytecode;
+    MP_BC_PRELUDE_SIG_DECODE(ip);
+    MP_BC_PRELUDE_SIZE_DECODE(ip);
+    const byte *line_info_top = ip + n_info;
+    const byte *bytecode_start = ip + n_info + n_cell;
+    const size_t bc = code_state->ip > bytecode_start ? (size_t)(code_state->ip - bytecode_start) : 0;
+    qstr block_name = mp_decode_uint_value(ip);
+    for (size_t i = 0; i < 1 + n_pos_args + n_kwonly_args; ++i) {
+        ip = mp_decode_uint_skip(ip);
+    }
+    #if MICROPY_EMIT_BYTECODE_USES_QSTR_TABLE
+    out->name = qstr_str(code_state->fun_bc->context->constants.qstr_table[block_name]);
+    out->file = qstr_str(code_state->fun_bc->context->constants.qstr_table[0]);
+    #else
+    out->name = qstr_str(block_name);
+    out->file = qstr_str(code_state->fun_bc->context->constants.source_file);
+    #endif
+    out->line = mp_bytecode_get_source_line(ip, line_info_top, bc);
+}
+
+void mp_port_prof_sample(void) {
+    const uint32_t ticks = __atomic_exchange_n(&mp_port_prof_pending, 0, __ATOMIC_RELAXED);
+    if (ticks == 0) {
+        return;
+    }
+    // stop takes the ring away under the lock, the python thread never waits for it
+    if (LightLock_TryLock(&ring_lock) != 0) {
+        __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    const mp_code_state_t *top = MP_STATE_THREAD(current_code_state);
+    if (ring != NULL && top != NULL) {
+        uint32_t depth = 0;
+        const mp_code_state_t *cs = top;
+        for (; cs != NULL && depth < MP_PORT_PROF_MAX_DEPTH; cs = cs->prev_state) {
+            ++depth;
+        }
+        // the oldest samples make room
+        while (MP_PORT_PROF_RING_FRAMES - (ring_head - ring_tail) < 1 + depth) {
+            ring_tail += 1 + (ring[ring_tail & RING_MASK].line & PROF_DEPTH_MASK);
+            __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+        }
+        prof_frame_t *header = &ring[ring_head++ & RING_MASK];
+        header->name = NULL;
+        header->ticks = ticks;
+        header->line = depth | (cs != NULL ? PROF_TRUNCATED : 0);
+        for (cs = top; depth-- > 0; cs = cs->prev_state) {
+            frame_of(cs, &ring[ring_head++ & RING_MASK]);
+        }
+    }
+    LightLock_Unlock(&ring_lock);
+}
+
+typedef struct _prof_sample_ref_t {
+    uint32_t hash;
+    uint32_t pos;
+} prof_sample_ref_t;
+
+static inline const prof_frame_t *ring_at(const prof_frame_t *frames, uint32_t pos) {
+    return &frames[pos & RING_MASK];
+}
+
+// qsort has no context argument, the ring being written out is this one
+static const prof_frame_t *sorting;
+
+static int sample_cmp(const void *a_arg, const void *b_arg) {
+    const prof_sample_ref_t *a = a_arg, *b = b_arg;
+    if (a->hash != b->hash) {
+        return a->hash < b->hash ? -1 : 1;
+    }
+    const uint32_t a_header = ring_at(sorting, a->pos)->line, b_header = ring_at(sorting, b->pos)->line;
+    if (a_header != b_header) {
+        return a_header < b_header ? -1 : 1;
+    }
+    for (uint32_t i = 1; i <= (a_header & PROF_DEPTH_MASK); ++i) {
+        const prof_frame_t *fa = ring_at(sorting, a->pos + i), *fb = ring_at(sorting, b->pos + i);
+        // the same qstr always gives the same string, so the pointers tell frames apart
+        if (fa->name != fb->name) {
+            return (uintptr_t)fa->name < (uintptr_t)fb->name ? -1 : 1;
+        }
+        if (fa->file != fb->file) {
+            return (uintptr_t)fa->file < (uintptr_t)fb->file ? -1 : 1;
+        }
+        if (fa->line != fb->line) {
+            return fa->line < fb->line ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static uint32_t sample_hash(const prof_frame_t *frames, uint32_t pos) {
+    // FNV-1a over the depth and the frames
+    uint32_t hash = 2166136261u;
+    const uint32_t header = ring_at(frames, pos)->line;
+    hash = (hash ^ header) * 16777619u;
+    for (uint32_t i = 1; i <= (header & PROF_DEPTH_MASK); ++i) {
+        const prof_frame_t *f = ring_at(frames, pos + i);
+        hash = (hash ^ (uint32_t)(uintptr_t)f->name) * 16777619u;
+        hash = (hash ^ (uint32_t)(uintptr_t)f->file) * 16777619u;
+        hash = (hash ^ f->line) * 16777619u;
+    }
+    return hash;
+}
+
+// root first, as flame graph tools read them
+static void write_stack(FILE *out, const prof_frame_t *frames, uint32_t pos) {
+    const uint32_t header = ring_at(frames, pos)->line;
+    const uint32_t depth = header & PROF_DEPTH_MASK;
+    if (header & PROF_TRUNCATED) {
+        fputs("[truncated];", out);
+    }
+    for (uint32_t i = depth; i >= 1; --i) {
+        const prof_frame_t *f = ring_at(frames, pos + i);
+        fprintf(out, "%s (%s:%lu)%s", f->name, f->file, (unsigned long)f->line, i > 1 ? ";" : "");
+    }
+}
+
+// identical stacks get merged, so a long run writes each distinct stack once
+static int write_folded(const prof_frame_t *frames, uint32_t head, uint32_t tail, const char *path, mp_port_prof_stats_t *stats) {
+    size_t count = 0;
+    for (uint32_t pos = tail; pos != head; pos += 1 + (ring_at(frames, pos)->line & PROF_DEPTH_MASK)) {
+        ++count;
+    }
+    prof_sample_ref_t *refs = malloc((count ? count : 1) * sizeof(*refs));
+    if (refs == NULL) {
+        return ENOMEM;
+    }
+    size_t n = 0;
+    for (uint32_t pos = tail; pos != head; pos += 1 + (ring_at(frames, pos)->line & PROF_DEPTH_MASK)) {
+        refs[n].hash = sample_hash(frames, pos);
+        refs[n].pos = pos;
+        ++n;
+    }
+    sorting = frames;
+    qsort(refs, count, sizeof(*refs), sample_cmp);
+
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        const int err = errno;
+        free(refs);
+        return err;
+    }
+    for (size_t i = 0; i < count;) {
+        uint32_t ticks = 0;
+        size_t j = i;
+        for (; j < count && sample_cmp(&refs[i], &refs[j]) == 0; ++j) {
+            ticks += ring_at(frames, refs[j].pos)->ticks;
+        }
+        write_stack(out, frames, refs[i].pos);
+        fprintf(out, " %lu\n", (unsigned long)ticks);
+        stats->samples += j - i;
+        stats->ticks += ticks;
+        stats->stacks += 1;
+        i = j;
+    }
+    free(refs);
+    const int err = ferror(out) ? EIO : 0;
+    return fclose(out) != 0 && err == 0 ? errno : err;
+}
+
+static void writer_func(void *arg) {
+    prof_write_t *job = arg;
+    mp_port_prof_stats_t stats = {0};
+    const int err = write_folded(job->frames, job->head, job->tail, job->path, &stats);
+    stats.dropped = job->dropped;
+    free(job->frames);
+    free(job->path);
+    free(job);
+
+    LightLock_Lock(&ctl_lock);
+    write_stats = stats;
+    write_err = err;
+    write_done = true;
+    LightLock_Unlock(&ctl_lock);
+}
+
+#endif // MICROPY_PORT_PROFILER
+
+void mp_port_prof_init(void) {
+    LightLock_Init(&ctl_lock);
+    #if MICROPY_PORT_PROFILER
+    LightLock_Init(&ring_lock);
+    LightEvent_Init(&timer_stop, RESET_STICKY);
+    #endif
+}
+
+void mp_port_prof_set_default_path(const char *path) {
+    LightLock_Lock(&ctl_lock);
+    free(default_path);
+    default_path = path ? strdup(path) : NULL;
+    LightLock_Unlock(&ctl_lock);
+}
+
+int mp_port_prof_start(uint32_t interval_us, const char *path) {
+    #if MICROPY_PORT_PROFILER
+    LightLock_Lock(&ctl_lock);
+    int err = 0;
+    if (running) {
+        err = EALREADY;
+        goto out;
+    }
+    if (writer != NULL) {
+        // its strings and the new run's would mix in the ring otherwise, and it's only one file at a time anyway
+        if (threadJoin(writer, 0) != 0) {
+            err = EBUSY;
+            goto out;
+        }
+        threadFree(writer);
+        writer = NULL;
+    }
+    if (path == NULL) {
+        path = default_path ? default_path : MP_PORT_PROF_DEFAULT_PATH;
+    }
+    run_path = strdup(path);
+    prof_frame_t *frames = malloc(MP_PORT_PROF_RING_FRAMES * sizeof(prof_frame_t));
+    if (run_path == NULL || frames == NULL) {
+        free(frames);
+        free(run_path);
+        run_path = NULL;
+        err = ENOMEM;
+        goto out;
+    }
+
+    LightLock_Lock(&ring_lock);
+    ring = frames;
+    ring_head = ring_tail = 0;
+    dropped = 0;
+    LightLock_Unlock(&ring_lock);
+    __atomic_store_n(&mp_port_prof_pending, 0, __ATOMIC_RELAXED);
+
+    // above the python thread, or a busy loop would keep it from ticking
+    LightEvent_Clear(&timer_stop);
+    if (interval_us < 100) {
+        interval_us = 100;
+    }
+    timer = threadCreate(timer_func, (void *)(uintptr_t)interval_us, 4096, 0x2f, -2, false);
+    if (timer == NULL) {
+        LightLock_Lock(&ring_lock);
+        ring = NULL;
+        LightLock_Unlock(&ring_lock);
+        free(frames);
+        free(run_path);
+        run_path = NULL;
+        err = EAGAIN;
+        goto out;
+    }
+    running = true;
+out:
+    LightLock_Unlock(&ctl_lock);
+    return err;
+    #else
+    (void)interval_us;
+    (void)path;
+    return EOPNOTSUPP;
+    #endif
+}
+
+int mp_port_prof_stop(void) {
+    #if MICROPY_PORT_PROFILER
+    LightLock_Lock(&ctl_lock);
+    if (!running) {
+        LightLock_Unlock(&ctl_lock);
+        return EINVAL;
+    }
+    running = false;
+    LightEvent_Signal(&timer_stop);
+    threadJoin(timer, U64_MAX);
+    threadFree(timer);
+    timer = NULL;
+
+    // once the ring is taken away, samples are skipped and it can be read without holding anything up
+    LightLock_Lock(&ring_lock);
+    prof_frame_t *frames = ring;
+    const uint32_t head = ring_head, tail = ring_tail;
+    ring = NULL;
+    LightLock_Unlock(&ring_lock);
+    __atomic_store_n(&mp_port_prof_pending, 0, __ATOMIC_RELAXED);
+
+    // sorting and writing to the SD card take a while, below the UI and python threads
+    prof_write_t *job = malloc(sizeof(*job));
+    if (job != NULL) {
+        *job = (prof_write_t) { frames, head, tail, run_path, dropped };
+        writer = threadCreate(writer_func, job, 16 * 1024, 0x32, -2, false);
+    }
+    if (job == NULL || writer == NULL) {
+        free(job);
+        free(frames);
+        free(run_path);
+        write_stats = (mp_port_prof_stats_t) { .dropped = dropped };
+        write_err = ENOMEM;
+        write_done = true;
+    }
+    run_path = NULL;
+    LightLock_Unlock(&ctl_lock);
+    return 0;
+    #else
+    return EINVAL;
+    #endif
+}
+
+int mp_port_prof_wait(mp_port_prof_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    #if MICROPY_PORT_PROFILER
+    // not held while joining, the UI can start the next run meanwhile
+    LightLock_Lock(&ctl_lock);
+    Thread w = writer;
+    writer = NULL;
+    LightLock_Unlock(&ctl_lock);
+    if (w != NULL) {
+        threadJoin(w, U64_MAX);
+        threadFree(w);
+    }
+
+    LightLock_Lock(&ctl_lock);
+    int err = EINVAL;
+    if (write_done) {
+        *stats = write_stats;
+        err = write_err;
+        write_done = false;
+    }
+    LightLock_Unlock(&ctl_lock);
+    return err;
+    #else
+    return EINVAL;
+    #endif
+}
+
+bool mp_port_prof_running(void) {
+    #if MICROPY_PORT_PROFILER
+    return running;
+    #else
+    return false;
+    #endif
+}
+
+#if !MICROPY_PORT_PROFILER
+void mp_port_prof_sample(void) {
+    __atomic_store_n(&mp_port_prof_pending, 0, __ATOMIC_RELAXED);
+}
+#endif
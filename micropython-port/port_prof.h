@@ -0,0 +1,53 @@
+#ifndef MICROPY_INCLUDED_PORT_PROF_H
+#define MICROPY_INCLUDED_PORT_PROF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// a sampling profiler: a timer thread counts ticks while python code runs, and the python thread records
+// its chain of code states (function, file and line) into a ring buffer at its next VM checkpoint,
+// weighted by the ticks since the last sample; stopping has a thread of its own write the stacks folded,
+// one line per distinct stack:
+//   <module> (main.py:12);draw (ui.py:40);text_width (ui.py:8) 37
+// only bytecode frames show up, time in native code and C functions goes to the bytecode frame that called it
+// it needs sys.settrace's code state chain, so it's only there when built with PROFILER=1, see mpconfigport.h
+
+// used when start gets no interval or no path
+#define MP_PORT_PROF_DEFAULT_INTERVAL_US (1000)
+#define MP_PORT_PROF_DEFAULT_PATH "profile.folded"
+// frames per sample, deeper stacks keep their innermost frames under a [truncated] root
+#define MP_PORT_PROF_MAX_DEPTH (48)
+// the ring holds this many frames, the oldest samples get overwritten once it's full
+#define MP_PORT_PROF_RING_FRAMES (16 * 1024)
+
+typedef struct _mp_port_prof_stats_t {
+    // samples written, the ticks they stand for, and the distinct stacks among them
+    uint32_t samples;
+    uint32_t ticks;
+    uint32_t stacks;
+    // overwritten in the ring, or skipped because the ring was being taken away
+    uint32_t dropped;
+} mp_port_prof_stats_t;
+
+// before anything else here
+void mp_port_prof_init(void);
+// these return 0 or an errno value, and are safe from any thread
+// EALREADY when running, EBUSY while the last run is still being written, ENOMEM when the ring can't be
+// allocated; path is copied, NULL means the default path
+int mp_port_prof_start(uint32_t interval_us, const char *path);
+// stops sampling and hands the samples to a writer thread, which writes them to the path start was given;
+// doesn't wait for the file, EINVAL when not running
+int mp_port_prof_stop(void);
+// waits for the last stopped run to be written, EINVAL when there's none since the last wait, the errno of
+// the failed write otherwise; stats is filled in either way
+// the python thread has to wait before the heap goes away, the stacks name strings that live in it
+int mp_port_prof_wait(mp_port_prof_stats_t *stats);
+bool mp_port_prof_running(void);
+// what a NULL path means from now on, copied
+void mp_port_prof_set_default_path(const char *path);
+
+// MICROPY_VM_HOOK_LOOP: ticks went by since the last sample, the python thread records its stack
+extern volatile uint32_t mp_port_prof_pending;
+void mp_port_prof_sample(void);
+
+#endif // MICROPY_INCLUDED_PORT_PROF_H
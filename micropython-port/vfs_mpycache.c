@@ -0,0 +1,260 @@
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "py/runtime.h"
+#include "py/compile.h"
+#include "py/persistentcode.h"
+#include "py/builtin.h"
+#include "py/lexer.h"
+#include "py/nlr.h"
+#include "extmod/vfs.h"
+#include "vfs_mpycache.h"
+
+// appended after the bytecode, the loader stops reading before it
+// the .mpy header fields of the interpreter that wrote it come along, one built from another micropython
+// or for another arch would fail to load, or not be native code this one can run
+typedef struct _mpycache_key_t {
+    char magic[4];
+    uint8_t mpy_version;
+    uint8_t mpy_features;
+    uint8_t small_int_bits;
+    uint8_t reserved;
+    uint32_t size;
+    uint64_t mtime;
+} mpycache_key_t;
+
+static const char MPYCACHE_MAGIC[4] = {'M', 'P', 'Y', 'C'};
+
+// the feature byte mp_raw_code_save writes: the arch of native code, and the sub-version since it has one
+#ifdef MPY_SUB_VERSION
+#define MPYCACHE_FEATURES (MPY_FEATURE_ENCODE_SUB_VERSION(MPY_SUB_VERSION) | MPY_FEATURE_ENCODE_ARCH(MPY_FEATURE_ARCH))
+#else
+#define MPYCACHE_FEATURES (MPY_FEATURE_ENCODE_FLAGS(MPY_FEATURE_FLAGS) | MPY_FEATURE_ENCODE_ARCH(MPY_FEATURE_ARCH))
+#endif
+
+// FAT keeps mtimes in 2 second steps: a source saved again within the same step as the one that got cached
+// could keep its size and mtime, so sources this recent are imported as they are and not cached
+#define MPYCACHE_MTIME_GRANULARITY_S (2)
+
+typedef struct _mp_obj_vfs_mpycache_t {
+    mp_obj_base_t base;
+    mp_obj_t inner;
+} mp_obj_vfs_mpycache_t;
+
+// stat through the wrapped VFS, paths here are relative to it; false when it raised, like for a missing file
+static bool inner_stat(mp_obj_vfs_mpycache_t *self, const char *path, mp_int_t *size, mp_int_t *mtime) {
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_obj_t call[3];
+        mp_load_method(self->inner, MP_QSTR_stat, call);
+        call[2] = mp_obj_new_str(path, strlen(path));
+        mp_obj_t *fields;
+        mp_obj_get_array_fixed_n(mp_call_method_n_kw(1, 0, call), 10, &fields);
+        *size = mp_obj_get_int_truncated(fields[6]);
+        *mtime = mp_obj_get_int_truncated(fields[8]);
+        nlr_pop();
+        return true;
+    }
+    return false;
+}
+
+static void inner_remove(mp_obj_vfs_mpycache_t *self, const char *path) {
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_obj_t call[3];
+        mp_load_method(self->inner, MP_QSTR_remove, call);
+        call[2] = mp_obj_new_str(path, strlen(path));
+        mp_call_method_n_kw(1, 0, call);
+        nlr_pop();
+    }
+}
+
+// false when the source can't be seen, or is too recent for its mtime to tell versions apart
+static bool source_key(mp_obj_vfs_mpycache_t *self, const char *py_path, mpycache_key_t *key) {
+    mp_int_t size, mtime;
+    if (!inner_stat(self, py_path, &size, &mtime)) {
+        return false;
+    }
+    if (mtime + MPYCACHE_MTIME_GRANULARITY_S > (mp_int_t)time(NULL)) {
+        return false;
+    }
+    memset(key, 0, sizeof(*key));
+    memcpy(key->magic, MPYCACHE_MAGIC, sizeof(key->magic));
+    key->mpy_version = MPY_VERSION;
+    key->mpy_features = MPYCACHE_FEATURES;
+    key->small_int_bits = MP_SMALL_INT_BITS;
+    key->size = size;
+    key->mtime = mtime;
+    return true;
+}
+
+// a cache written for another source, or by an interpreter that can't load it, is compiled again
+static bool same_key(const mpycache_key_t *a, const mpycache_key_t *b) {
+    return a->mpy_version == b->mpy_version && a->mpy_features == b->mpy_features
+        && a->small_int_bits == b->small_int_bits && a->size == b->size && a->mtime == b->mtime;
+}
+
+static bool cached_key(const char *mpy_path, mpycache_key_t *key) {
+    FILE *f = fopen(mpy_path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    const bool ok = fseek(f, -(long)sizeof(*key), SEEK_END) == 0
+        && fread(key, sizeof(*key), 1, f) == 1
+        && memcmp(key->magic, MPYCACHE_MAGIC, sizeof(key->magic)) == 0;
+    fclose(f);
+    return ok;
+}
+
+// compiles py_path into mpy_path, followed by key; false if either step failed
+// mp_raw_code_save_file writes with the OS calls, so this part takes the path as the OS's, see vfs_mpycache.h
+static bool compile_to_cache(const char *py_path, const char *mpy_path, const mpycache_key_t *key) {
+    // don't spend a compile on a location that can't be written, like romfs
+    FILE *probe = fopen(mpy_path, "wb");
+    if (probe == NULL) {
+        return false;
+    }
+    fclose(probe);
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_lexer_t *lex = mp_lexer_new_from_file(py_path);
+        qstr source_name = lex->source_name;
+        mp_parse_tree_t parse_tree = mp_parse(lex, MP_PARSE_FILE_INPUT);
+        mp_module_context_t *ctx = m_new_obj(mp_module_context_t);
+        ctx->module.globals = mp_globals_get();
+        mp_compiled_module_t cm;
+        cm.context = ctx;
+        mp_compile_to_raw_code(&parse_tree, source_name, false, &cm);
+        mp_raw_code_save_file(&cm, mpy_path);
+        nlr_pop();
+    } else {
+        // a syntax error gets reported by the regular import of the source
+        remove(mpy_path);
+        return false;
+    }
+
+    FILE *f = fopen(mpy_path, "ab");
+    if (f == NULL || fwrite(key, sizeof(*key), 1, f) != 1) {
+        if (f != NULL) {
+            fclose(f);
+        }
+        remove(mpy_path);
+        return false;
+    }
+    fclose(f);
+    return true;
+}
+
+static bool has_suffix(const char *path, size_t len, const char *suffix) {
+    const size_t suffix_len = strlen(suffix);
+    return len >= suffix_len && memcmp(path + len - suffix_len, suffix, suffix_len) == 0;
+}
+
+static mp_import_stat_t mpycache_import_stat(void *self_in, const char *path) {
+    mp_obj_vfs_mpycache_t *self = self_in;
+    const mp_vfs_proto_t *inner_proto = MP_OBJ_TYPE_GET_SLOT(mp_obj_get_type(self->inner), protocol);
+    const mp_import_stat_t st = inner_proto->import_stat(MP_OBJ_TO_PTR(self->inner), path);
+    if (st != MP_IMPORT_STAT_FILE) {
+        return st;
+    }
+
+    const size_t len = strlen(path);
+    char other[MICROPY_ALLOC_PATH_MAX + 2];
+    if (len + 2 > sizeof(other)) {
+        return st;
+    }
+
+    if (has_suffix(path, len, ".py")) {
+        // x.py -> x.mpy; saying the source isn't there makes the import look for the .mpy next
+        memcpy(other, path, len - 2);
+        strcpy(other + len - 2, "mpy");
+        mpycache_key_t want, have;
+        if (!source_key(self, path, &want)) {
+            return st;
+        }
+        if (cached_key(other, &have) && same_key(&have, &want)) {
+            return MP_IMPORT_STAT_NO_EXIST;
+        }
+        return compile_to_cache(path, other, &want) ? MP_IMPORT_STAT_NO_EXIST : st;
+    }
+    if (has_suffix(path, len, ".mpy")) {
+        // a cache whose source went away is stale
+        mpycache_key_t have;
+        if (cached_key(path, &have)) {
+            memcpy(other, path, len - 3);
+            strcpy(other + len - 3, "py");
+            mp_int_t size, mtime;
+            if (!inner_stat(self, other, &size, &mtime)) {
+                inner_remove(self, path);
+                return MP_IMPORT_STAT_NO_EXIST;
+            }
+        }
+    }
+    return st;
+}
+
+// everything but import_stat goes to the wrapped VFS unchanged
+static mp_obj_t mpycache_forward(qstr attr, size_t n_args, const mp_obj_t *args) {
+    mp_obj_vfs_mpycache_t *self = MP_OBJ_TO_PTR(args[0]);
+    mp_obj_t call[2 + 4];
+    mp_load_method(self->inner, attr, call);
+    for (size_t i = 1; i < n_args; ++i) {
+        call[1 + i] = args[i];
+    }
+    return mp_call_method_n_kw(n_args - 1, 0, call);
+}
+
+#define MPYCACHE_FORWARD(name, min_args, max_args) \
+    static mp_obj_t mpycache_##name(size_t n_args, const mp_obj_t *args) { \
+        return mpycache_forward(MP_QSTR_##name, n_args, args); \
+    } \
+    static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mpycache_##name##_obj, min_args, max_args, mpycache_##name);
+
+MPYCACHE_FORWARD(mount, 3, 3)
+MPYCACHE_FORWARD(umount, 1, 1)
+MPYCACHE_FORWARD(open, 3, 3)
+MPYCACHE_FORWARD(chdir, 2, 2)
+MPYCACHE_FORWARD(getcwd, 1, 1)
+MPYCACHE_FORWARD(ilistdir, 1, 2)
+MPYCACHE_FORWARD(mkdir, 2, 2)
+MPYCACHE_FORWARD(remove, 2, 2)
+MPYCACHE_FORWARD(rename, 3, 3)
+MPYCACHE_FORWARD(rmdir, 2, 2)
+MPYCACHE_FORWARD(stat, 2, 2)
+MPYCACHE_FORWARD(statvfs, 2, 2)
+
+static const mp_rom_map_elem_t mpycache_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_mount), MP_ROM_PTR(&mpycache_mount_obj) },
+    { MP_ROM_QSTR(MP_QSTR_umount), MP_ROM_PTR(&mpycache_umount_obj) },
+    { MP_ROM_QSTR(MP_QSTR_open), MP_ROM_PTR(&mpycache_open_obj) },
+    { MP_ROM_QSTR(MP_QSTR_chdir), MP_ROM_PTR(&mpycache_chdir_obj) },
+    { MP_ROM_QSTR(MP_QSTR_getcwd), MP_ROM_PTR(&mpycache_getcwd_obj) },
+    { MP_ROM_QSTR(MP_QSTR_ilistdir), MP_ROM_PTR(&mpycache_ilistdir_obj) },
+    { MP_ROM_QSTR(MP_QSTR_mkdir), MP_ROM_PTR(&mpycache_mkdir_obj) },
+    { MP_ROM_QSTR(MP_QSTR_remove), MP_ROM_PTR(&mpycache_remove_obj) },
+    { MP_ROM_QSTR(MP_QSTR_rename), MP_ROM_PTR(&mpycache_rename_obj) },
+    { MP_ROM_QSTR(MP_QSTR_rmdir), MP_ROM_PTR(&mpycache_rmdir_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stat), MP_ROM_PTR(&mpycache_stat_obj) },
+    { MP_ROM_QSTR(MP_QSTR_statvfs), MP_ROM_PTR(&mpycache_statvfs_obj) },
+};
+static MP_DEFINE_CONST_DICT(mpycache_locals_dict, mpycache_locals_dict_table);
+
+static const mp_vfs_proto_t mpycache_proto = {
+    .import_stat = mpycache_import_stat,
+};
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    mp_type_vfs_mpycache,
+    MP_QSTR_VfsMpyCache,
+    MP_TYPE_FLAG_NONE,
+    protocol, &mpycache_proto,
+    locals_dict, &mpycache_locals_dict
+    );
+
+mp_obj_t mp_vfs_mpycache_new(mp_obj_t inner) {
+    mp_obj_vfs_mpycache_t *self = mp_obj_malloc(mp_obj_vfs_mpycache_t, &mp_type_vfs_mpycache);
+    self->inner = inner;
+    return MP_OBJ_FROM_PTR(self);
+}
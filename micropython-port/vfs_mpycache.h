@@ -0,0 +1,14 @@
+#ifndef MICROPY_INCLUDED_VFS_MPYCACHE_H
+#define MICROPY_INCLUDED_VFS_MPYCACHE_H
+
+#include "py/obj.h"
+
+// wraps another VFS so that importing x.py compiles it once into x.mpy next to it, and loads that afterwards
+// the .mpy ends with the source's size and mtime and the .mpy version it was written as, a source that changed
+// or went away invalidates it, as does a micropython update that changes the format,
+// and a source changed in the last 2 seconds is imported without the cache since FAT can't tell it apart yet
+// sources are looked at through inner, but the .mpy is read and written with the OS's file calls, so inner
+// has to take paths the way the OS does, like a VfsPosix without a root
+mp_obj_t mp_vfs_mpycache_new(mp_obj_t inner);
+
+#endif // MICROPY_INCLUDED_VFS_MPYCACHE_H
@@ -2,20 +2,36 @@
 
 extern "C" {
 #include "py/repl.h"
+#include "port_heap.h"
 }
 
 static std::string_view import_search_paths[] = {
+#if MICROPY_MODULE_FROZEN
+    // modules built into the binary with FROZEN=1, found without going to the SD card
+    ".frozen",
+#endif
     "sdmc:/python-lib",
     "sdmc:/python-work",
 };
+// heap and stack sizes for python, see heap_config.h
+static const char heap_config_path[] = "sdmc:/python-work/heap.cfg";
+// create the folder to keep a log of everything scripts print
+static const output_log::settings output_log_settings{
+    "sdmc:/python-logs/output.log",
+};
+// where the profiler writes its folded stacks when python doesn't say
+static const char profile_path[] = "sdmc:/python-logs/profile.folded";
 
-application::application(C2D_Font fnt, C2D_SpriteSheet sprites)
-    : handler(import_search_paths)
-    , scr(fnt)
+application::application(C2D_Font fnt, C2D_SpriteSheet sprites, C3D_RenderTarget* top)
+    : handler(import_search_paths, output_log_settings, heap_config::load(heap_config_path, osGetMemRegionFree(MEMREGION_APPLICATION)))
+    , scr_backend(fnt, top)
+    , scr(scr_backend)
     , keyboard_tbuf(C2D_TextBufNew(512))
+    , overlay_tbuf(C2D_TextBufNew(256))
     , mono_font(fnt)
 {
     set_keyboard_color(C2D_Color32(0,172,0,255));
+    handler.set_profile_path(profile_path);
 
     left_img = C2D_SpriteSheetGetImage(sprites, 0);
     right_img = C2D_SpriteSheetGetImage(sprites, 1);
@@ -32,9 +48,15 @@ application::application(C2D_Font fnt, C2D_SpriteSheet sprites)
 
     start_repl_line(false);
 }
+application::~application()
+{
+    C2D_TextBufDelete(overlay_tbuf);
+    C2D_TextBufDelete(keyboard_tbuf);
+}
 
 void application::press_key(std::string_view key, bool repeat)
 {
+    scr.reset_view();
     if(currently() == mode::repl)
     {
         if(key == "\n")
@@ -128,6 +150,7 @@ void application::click_release()
         switch(currently())
         {
         case mode::repl:
+            scr.reset_view();
             if(keeb.do_press(last_click_x, last_click_y, [&](const char c) { typing_callback_repl(c); }))
             {
                 send_repl_line();
@@ -139,6 +162,14 @@ void application::click_release()
     }
 }
 
+void application::page_output(bool back)
+{
+    if(back)
+        scr.scroll_back(scr.rows());
+    else
+        scr.scroll_forward(scr.rows());
+}
+
 void application::send_repl_line()
 {
     if(hist.is_hovering())
@@ -159,7 +190,8 @@ void application::send_repl_line()
     else
     {
         handler.write(final_upload);
-        scr.print("\e[25m");
+        // program output wraps, only the line being edited scrolls sideways
+        scr.print("\e[25m\e[?7h");
         final_upload.clear();
         set_mode(mode::waiting);
     }
@@ -168,7 +200,7 @@ void application::send_repl_line()
 void application::start_repl_line(bool is_cont)
 {
     set_mode(mode::repl);
-    scr.print("\e[0m");
+    scr.print("\e[0m\e[?7l");
     scr.print(is_cont ? "... " : ">>> ");
 }
 
@@ -232,29 +264,61 @@ void application::tick()
     scr.tick();
 }
 
-void application::read_output(unsigned up_to)
+void application::read_output(u64 budget_us)
 {
-    std::string current_read;
+    // a backlog deeper than a screen is parsed without drawing until it's gone, see frame_due
+    if(!fast_forward && handler.pending_output() > scr.columns() * scr.rows())
+    {
+        fast_forward = true;
+        fast_forward_drawn = svcGetSystemTick();
+    }
+    if(fast_forward)
+    {
+        budget_us = std::max(budget_us, FAST_FORWARD_BUDGET_US);
+    }
+    const u64 start = svcGetSystemTick();
+    const u64 budget_ticks = budget_us * (SYSCLOCK_ARM11 / 1000000);
+
+    std::string_view current_read;
     int current_read_status = 0;
-    while(--up_to && (current_read_status = handler.read(current_read)) == 1)
+    while((current_read_status = handler.read(current_read)) == 1)
     {
-        std::string_view sv(current_read);
-        while((sv.size() + scr.cursor_x + scr.scroll_x) >= scr.columns())
+        current_read = current_read.substr(0, READ_SLICE);
+        scr.print(current_read);
+        handler.consume(current_read.size());
+        if(svcGetSystemTick() - start >= budget_ticks)
         {
-            auto sub = sv.substr(0, scr.columns() - (scr.cursor_x + scr.scroll_x));
-            scr.print(sub);
-            scr.print("\n");
-            sv.remove_prefix(sub.size());
+            break;
         }
-        scr.print(sv);
+    }
+    if(current_read_status != 1)
+    {
+        fast_forward = false;
     }
 
-    if(up_to && current_read_status == 0 && currently() == mode::waiting)
+    if(current_read_status == 0 && currently() == mode::waiting)
     {
         start_repl_line(false);
     }
 }
 
+bool application::frame_due()
+{
+    if(!fast_forward)
+    {
+        return true;
+    }
+    // a script that never stops printing still shows progress now and then
+    const u64 now = svcGetSystemTick();
+    if(now - fast_forward_drawn < FAST_FORWARD_DRAW_INTERVAL_US * (SYSCLOCK_ARM11 / 1000000))
+    {
+        svcSleepThread(FAST_FORWARD_YIELD_US * 1000);
+        return false;
+    }
+    fast_forward_drawn = now;
+    return true;
+}
+
 std::optional<int> application::return_value() const
 {
     return handler.should_exit();
@@ -266,9 +330,67 @@ void application::set_keyboard_color(u32 color)
     C2D_PlainImageTint(&keyboard_sprite_tint, color, 1.0f);
 }
 
+void application::toggle_gc_overlay()
+{
+    show_gc_overlay = !show_gc_overlay;
+    // the overlay shows free memory, which only gets measured with the heap walk on
+    mp_port_gc_stats_set_heap_walk(show_gc_overlay);
+}
+
+void application::toggle_profiler()
+{
+    handler.toggle_profiler();
+}
+
 void application::draw_top()
 {
     scr.draw();
+    if(show_gc_overlay)
+    {
+        draw_gc_overlay();
+    }
+    // a red corner while the profiler samples
+    if(handler.profiling())
+    {
+        C2D_DrawRectSolid(0.0f, 0.0f, 0.95f, 6.0f, 6.0f, C2D_Color32(255, 0, 0, 255));
+    }
+}
+
+void application::draw_gc_overlay()
+{
+    mp_port_gc_stats_t s;
+    mp_port_gc_stats_get(&s);
+
+    // the histogram as counts per bucket, the last one being everything past 100ms
+    char hist[64];
+    int used = 0;
+    for(std::size_t i = 0; i < MP_PORT_GC_PAUSE_BUCKETS && used < int(sizeof(hist)); ++i)
+    {
+        used += snprintf(hist + used, sizeof(hist) - used, i ? " %lu" : "%lu", (unsigned long)s.pause_histogram[i]);
+    }
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+        "gc: %lu runs, last %lu.%02lums, max %lu.%02lums\n"
+        "heap: %u/%u KiB free, largest %u KiB\n"
+        "freed: %u KiB last, %lu KiB total\n"
+        "pauses <1/2/5/10/20/50/100ms/more:\n%s",
+        (unsigned long)s.collections,
+        (unsigned long)(s.pause_last_us / 1000), (unsigned long)(s.pause_last_us % 1000 / 10),
+        (unsigned long)(s.pause_max_us / 1000), (unsigned long)(s.pause_max_us % 1000 / 10),
+        unsigned(s.heap_free / 1024), unsigned(s.heap_total / 1024), unsigned(s.largest_free_block / 1024),
+        unsigned(s.freed_last / 1024), (unsigned long)(s.freed_total / 1024),
+        hist);
+
+    C2D_TextBufClear(overlay_tbuf);
+    C2D_Text txt;
+    C2D_TextFontParse(&txt, mono_font, overlay_tbuf, buf);
+    const float scale = 0.5f;
+    float w = 0.0f, h = 0.0f;
+    C2D_TextGetDimensions(&txt, scale, scale, &w, &h);
+    const float x = 400.0f - w - 4.0f, y = 2.0f;
+    C2D_DrawRectSolid(x - 2.0f, y - 1.0f, 0.9f, w + 4.0f, h + 2.0f, C2D_Color32(0, 0, 0, 200));
+    C2D_DrawText(&txt, C2D_WithColor, x, y, 0.95f, scale, scale, C2D_Color32(255, 255, 0, 255));
 }
 
 void application::draw_bottom()
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <3ds.h>
+#include <citro3d.h>
+#include <citro2d.h>
+
 #include "keyboard.h"
+#include "citro2d_backend.h"
 #include "screen.h"
 #include "history.h"
 #include "python_handler.h"
@@ -12,15 +17,26 @@ struct application {
         repl,
     };
 
-    application(C2D_Font fnt, C2D_SpriteSheet sprites);
+    application(C2D_Font fnt, C2D_SpriteSheet sprites, C3D_RenderTarget* top);
+    ~application();
 
     void press_key(std::string_view key, bool repeat=false);
     void click_start_at(int x, int y);
     void click_move_to(int x, int y);
     void click_release();
+    void page_output(bool back);
+    // GC pauses and heap use drawn over the top screen
+    void toggle_gc_overlay();
+    // starts the sampling profiler, or stops it and has the profile written next to the output log
+    void toggle_profiler();
 
     void tick();
-    void read_output(unsigned up_to);
+    // prints pending output for about budget_us microseconds, longer while there's more than a screen of it
+    void read_output(u64 budget_us);
+    // false while a backlog is being fast-forwarded: the terminal model is updated but nothing gets drawn
+    // until the backlog is gone, or FAST_FORWARD_DRAW_INTERVAL_US went by, so intermediate screens cost no glyph
+    // layout or rendering; returning false sleeps FAST_FORWARD_YIELD_US for the python thread's sake
+    bool frame_due();
     std::optional<int> return_value() const;
 
     void set_keyboard_color(u32 color);
@@ -32,20 +48,36 @@ struct application {
 
 private:
     python_handler handler;
+    citro2d_backend scr_backend;
     screen scr;
     keyboard keeb;
     history hist;
 
+    // while the backlog is deeper than a screen, nothing drawn in between would stay visible anyway
+    static constexpr inline u64 FAST_FORWARD_BUDGET_US = 12000;
+    // a frame gets drawn this often even while fast-forwarding
+    static constexpr inline u64 FAST_FORWARD_DRAW_INTERVAL_US = 500000;
+    // slept in each skipped frame: the python thread is below the main thread on the same core,
+    // without vsync it would only get to print more once the backlog is gone
+    static constexpr inline u64 FAST_FORWARD_YIELD_US = 1000;
+    // the clock gets checked after each slice this big
+    static constexpr inline std::size_t READ_SLICE = 4096;
+
     void send_repl_line();
     void start_repl_line(bool is_cont);
 
     void typing_callback_repl(const char c);
+    void draw_gc_overlay();
 
     int start_click_x, start_click_y;
     int last_click_x, last_click_y;
 
     std::string final_upload;
     C2D_TextBuf keyboard_tbuf;
+    C2D_TextBuf overlay_tbuf;
+    bool show_gc_overlay{false};
+    bool fast_forward{false};
+    u64 fast_forward_drawn{0};
     C2D_Font mono_font;
     u32 keyboard_color;
     C2D_ImageTint keyboard_sprite_tint;
@@ -0,0 +1,60 @@
+#include "byte_ring.h"
+#include <algorithm>
+#include <cstring>
+#include <bit>
+
+byte_ring::byte_ring(std::size_t capacity_arg)
+    : data(std::make_unique<char[]>(std::bit_ceil(std::max<std::size_t>(capacity_arg, 2))))
+    , mask(std::bit_ceil(std::max<std::size_t>(capacity_arg, 2)) - 1)
+{
+
+}
+
+std::size_t byte_ring::write(std::string_view in)
+{
+    const auto h = head.load(std::memory_order_relaxed);
+    const auto t = tail.load(std::memory_order_acquire);
+    const auto count = std::min(in.size(), capacity() - (h - t));
+    if(!count)
+        return 0;
+
+    // at most two pieces, up to the end of the storage then from its start
+    const auto at = h & mask;
+    const auto first = std::min(count, capacity() - at);
+    std::memcpy(data.get() + at, in.data(), first);
+    std::memcpy(data.get(), in.data() + first, count - first);
+    head.store(h + count, std::memory_order_release);
+    return count;
+}
+std::size_t byte_ring::free_space() const
+{
+    return capacity() - size();
+}
+
+std::string_view byte_ring::readable() const
+{
+    const auto t = tail.load(std::memory_order_relaxed);
+    const auto h = head.load(std::memory_order_acquire);
+    const auto at = t & mask;
+    return {data.get() + at, std::min(h - t, capacity() - at)};
+}
+void byte_ring::consume(std::size_t count)
+{
+    const auto t = tail.load(std::memory_order_relaxed);
+    tail.store(t + count, std::memory_order_release);
+}
+
+std::size_t byte_ring::size() const
+{
+    // tail first: head never falls behind it, whatever happens in between
+    const auto t = tail.load(std::memory_order_acquire);
+    return head.load(std::memory_order_acquire) - t;
+}
+bool byte_ring::empty() const
+{
+    return size() == 0;
+}
+std::size_t byte_ring::capacity() const
+{
+    return mask + 1;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string_view>
+#include <memory>
+#include <atomic>
+
+// lock-free ring of bytes for exactly one producer thread and one consumer thread
+// nothing is allocated after construction
+struct byte_ring {
+    // rounded up to a power of two
+    explicit byte_ring(std::size_t capacity_arg);
+
+    // producer side: copies as much as fits, returns how much that was
+    std::size_t write(std::string_view data);
+    std::size_t free_space() const;
+
+    // consumer side: the longest contiguous readable slice, valid until consume()
+    std::string_view readable() const;
+    void consume(std::size_t count);
+
+    // never exact while the other side runs: the consumer can miss writes, so it gets a lower bound,
+    // the producer can miss reads, so it gets an upper bound
+    std::size_t size() const;
+    bool empty() const;
+    std::size_t capacity() const;
+
+private:
+    // keeps the two indices off each other's cache line
+    static constexpr inline std::size_t CACHE_LINE = 64;
+
+    std::unique_ptr<char[]> data;
+    std::size_t mask;
+    // both count every byte ever written/read, wrapping is harmless since only their difference matters
+    alignas(CACHE_LINE) std::atomic<std::size_t> head{0};
+    alignas(CACHE_LINE) std::atomic<std::size_t> tail{0};
+};
@@ -0,0 +1,134 @@
+#include "citro2d_backend.h"
+
+#include <cmath>
+#include <bit>
+
+citro2d_backend::citro2d_backend(C2D_Font fnt_arg, C3D_RenderTarget* screen_target_arg, std::size_t initial_capacity)
+    : fnt(fnt_arg)
+    , buf(C2D_TextBufNew(initial_capacity))
+    , capacity(initial_capacity)
+    , screen_target(screen_target_arg)
+{
+
+}
+citro2d_backend::~citro2d_backend()
+{
+    free_slots(slots);
+    free_slots(retired);
+    C2D_TextBufDelete(buf);
+}
+
+void citro2d_backend::load_glyph(glyph_index idx, char32_t c)
+{
+    if(texts.size() <= idx)
+        texts.resize(idx + 1);
+    if(C2D_TextBufGetNumGlyphs(buf) == capacity)
+        grow();
+
+    auto& txt = texts[idx];
+    u8 conversion_buf[5];
+    const ssize_t units = encode_utf8(conversion_buf, c);
+    if(units <= 0)
+    {
+        txt = C2D_Text{};
+        return;
+    }
+    conversion_buf[units] = 0;
+
+    C2D_TextFontParse(&txt, fnt, buf, (const char*)conversion_buf);
+    parses += 1;
+}
+void citro2d_backend::measure_glyph(glyph_index idx, float scale, float& width, float& height)
+{
+    C2D_TextGetDimensions(&texts[idx], scale, scale, &width, &height);
+}
+
+void citro2d_backend::draw_rect(float x, float y, float z, float w, float h, u32 color)
+{
+    C2D_DrawRectSolid(x, y, z, w, h, color);
+}
+void citro2d_backend::draw_glyph(glyph_index idx, float x, float y, float z, float scale, u32 color)
+{
+    C2D_DrawText(&texts[idx], C2D_WithColor, x, y, z, scale, scale, color);
+}
+
+void citro2d_backend::resize_row_cache(std::size_t count, float width, float height, u32 clear_color)
+{
+    row_clear = clear_color;
+    for(auto& s : slots)
+    {
+        if(s.target)
+            retired.push_back(s);
+    }
+    slots.assign(count, row_slot{});
+
+    // textures have power of two sides, at least 8
+    tex_width = std::bit_ceil(std::max(8u, unsigned(std::ceil(width))));
+    tex_height = std::bit_ceil(std::max(8u, unsigned(std::ceil(height))));
+    // render targets come out upside down
+    row_subtex = Tex3DS_SubTexture{
+        u16(std::ceil(width)), u16(std::ceil(height)),
+        0.0f, 1.0f,
+        std::ceil(width) / tex_width, 1.0f - std::ceil(height) / tex_height,
+    };
+}
+bool citro2d_backend::begin_row(std::size_t slot)
+{
+    // called inside a frame, so the previous one is done with these
+    free_slots(retired);
+
+    auto& s = slots[slot];
+    if(!s.target)
+    {
+        if(!C3D_TexInitVRAM(&s.tex, tex_width, tex_height, GPU_RGBA8))
+            return false;
+        s.target = C3D_RenderTargetCreateFromTex(&s.tex, GPU_TEXFACE_2D, 0, -1);
+        if(!s.target)
+        {
+            C3D_TexDelete(&s.tex);
+            return false;
+        }
+    }
+
+    C2D_TargetClear(s.target, row_clear);
+    C2D_SceneBegin(s.target);
+    return true;
+}
+void citro2d_backend::end_row()
+{
+    C2D_SceneBegin(screen_target);
+}
+void citro2d_backend::draw_row(std::size_t slot, float x, float y, float z)
+{
+    C2D_DrawImageAt(C2D_Image{&slots[slot].tex, &row_subtex}, x, y, z);
+}
+
+std::size_t citro2d_backend::parse_count() const
+{
+    return parses;
+}
+
+void citro2d_backend::free_slots(std::vector<row_slot>& from)
+{
+    for(auto& s : from)
+    {
+        if(s.target)
+        {
+            C3D_RenderTargetDelete(s.target);
+            C3D_TexDelete(&s.tex);
+        }
+    }
+    from.clear();
+}
+
+void citro2d_backend::grow()
+{
+    // the buffer may move, and every parsed text points at it
+    capacity *= 2;
+    buf = C2D_TextBufResize(buf, capacity);
+    for(auto& txt : texts)
+    {
+        if(txt.buf)
+            txt.buf = buf;
+    }
+}
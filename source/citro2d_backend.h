@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <3ds.h>
+#include <citro3d.h>
+#include <citro2d.h>
+
+#include "render_backend.h"
+
+// draws with citro2d, every glyph parsed once into one shared text buffer
+// cached rows are textures in VRAM rendered to in the same frame, before being drawn onto screen_target
+struct citro2d_backend : render_backend {
+    citro2d_backend(C2D_Font fnt_arg, C3D_RenderTarget* screen_target_arg, std::size_t initial_capacity = 256);
+    ~citro2d_backend() override;
+
+    void load_glyph(glyph_index idx, char32_t c) override;
+    void measure_glyph(glyph_index idx, float scale, float& width, float& height) override;
+
+    void draw_rect(float x, float y, float z, float w, float h, u32 color) override;
+    void draw_glyph(glyph_index idx, float x, float y, float z, float scale, u32 color) override;
+
+    void resize_row_cache(std::size_t slots, float width, float height, u32 clear_color) override;
+    bool begin_row(std::size_t slot) override;
+    void end_row() override;
+    void draw_row(std::size_t slot, float x, float y, float z) override;
+
+    std::size_t parse_count() const;
+
+private:
+    struct row_slot {
+        C3D_Tex tex;
+        C3D_RenderTarget* target{nullptr};
+    };
+
+    void grow();
+    void free_slots(std::vector<row_slot>& from);
+
+    C2D_Font fnt;
+    C2D_TextBuf buf;
+    std::size_t capacity;
+    std::size_t parses{0};
+    std::vector<C2D_Text> texts;
+
+    C3D_RenderTarget* screen_target;
+    std::vector<row_slot> slots;
+    // slots dropped by a resize, the GPU may still be reading them until the next frame starts
+    std::vector<row_slot> retired;
+    Tex3DS_SubTexture row_subtex{};
+    u16 tex_width{0}, tex_height{0};
+    u32 row_clear{0};
+};
@@ -4,18 +4,110 @@
 /*
  * Public domain C++ <thread>-ish implementation for libctru
  * VER 20220902060500
+ *
+ * Elsewhere the same classes sit on pthreads, so code using them also builds on a Linux host.
  */
 
+#ifdef __3DS__
 #include <3ds.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cerrno>
+#include <ctime>
+#include <exception>
+#endif
+#include <cstdint>
 #include <utility>
 #include <tuple>
+#include <functional>
 #include <atomic>
 #include <memory>
 #include <chrono>
+#include <algorithm>
+#include <stdexcept>
 #include <bits/unique_lock.h>
 
 namespace ctr {
 
+namespace detail {
+
+#ifdef __3DS__
+using native_thread = Thread;
+#else
+using native_thread = pthread_t;
+
+inline timespec to_timespec(std::chrono::nanoseconds ns)
+{
+    const auto secs = std::chrono::duration_cast<std::chrono::seconds>(ns);
+    return {static_cast<time_t>(secs.count()), static_cast<long>((ns - secs).count())};
+}
+
+// absolute deadline on clock, for the pthread calls that take one
+inline timespec deadline_after(clockid_t clock, std::chrono::nanoseconds ns)
+{
+    timespec now;
+    clock_gettime(clock, &now);
+    ns = std::max(ns, std::chrono::nanoseconds::zero()) + std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec);
+    return to_timespec(ns);
+}
+#endif
+
+// signaled once by a new thread when it is running, waited on by whoever started it
+class start_latch {
+#ifdef __3DS__
+    LightEvent m_event;
+
+public:
+    start_latch()
+    {
+        LightEvent_Init(&m_event, RESET_STICKY);
+    }
+    void signal()
+    {
+        LightEvent_Signal(&m_event);
+    }
+    void wait()
+    {
+        LightEvent_Wait(&m_event);
+    }
+#else
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t m_cv = PTHREAD_COND_INITIALIZER;
+    bool m_signaled = false;
+
+public:
+    start_latch() = default;
+    ~start_latch()
+    {
+        pthread_cond_destroy(&m_cv);
+        pthread_mutex_destroy(&m_lock);
+    }
+    void signal()
+    {
+        pthread_mutex_lock(&m_lock);
+        m_signaled = true;
+        pthread_cond_signal(&m_cv);
+        pthread_mutex_unlock(&m_lock);
+    }
+    void wait()
+    {
+        pthread_mutex_lock(&m_lock);
+        while(!m_signaled)
+        {
+            pthread_cond_wait(&m_cv, &m_lock);
+        }
+        pthread_mutex_unlock(&m_lock);
+    }
+#endif
+    start_latch(const start_latch&) = delete;
+    start_latch& operator=(const start_latch&) = delete;
+};
+
+}
+
 struct thread_id {
     friend class thread;
     friend class this_thread;
@@ -30,7 +122,7 @@ struct thread_id {
     {
         return m_id != rhs.m_id;
     }
-    
+
     bool operator<(thread_id rhs ) const noexcept
     {
         return m_id < rhs.m_id;
@@ -49,15 +141,35 @@ struct thread_id {
     }
 
 private:
-    Thread m_id{};
+    detail::native_thread m_id{};
 };
 
 struct thread_base {
+    // libctru's scale: 0x18 is the highest an application may use, 0x3F the lowest
+    static constexpr inline int default_prio = 0x30;
+    // no core asked for: the process' default core on 3DS, wherever the scheduler likes elsewhere
+    static constexpr inline int any_core = -1;
+
     template<class Rep, class Period>
     static void sleep_for(const std::chrono::duration<Rep, Period>& length)
     {
+#ifdef __3DS__
         svcSleepThread(std::chrono::duration_cast<std::chrono::nanoseconds>(length).count());
+#else
+        timespec left = detail::to_timespec(std::chrono::duration_cast<std::chrono::nanoseconds>(length));
+        while(nanosleep(&left, &left) == -1 && errno == EINTR)
+            ;
+#endif
     }
+
+#ifndef __3DS__
+    // each step away from default_prio is one nice level of the kernel thread tid; raising it above the default usually isn't allowed
+    static bool apply_prio(pid_t tid, int prio) noexcept
+    {
+        const int nice = std::clamp(prio - default_prio, -20, 19);
+        return setpriority(PRIO_PROCESS, tid, nice) == 0;
+    }
+#endif
 };
 struct this_thread : public thread_base {
     using id = thread_id;
@@ -68,57 +180,145 @@ struct this_thread : public thread_base {
         out.m_id = native_handle();
         return out;
     }
-    static Thread native_handle()
+    static detail::native_thread native_handle()
     {
+#ifdef __3DS__
         return threadGetCurrent();
+#else
+        return pthread_self();
+#endif
     }
     static void yield() noexcept
     {
+#ifdef __3DS__
         svcSleepThread(1);
+#else
+        sched_yield();
+#endif
+    }
+
+    // the core running the calling thread right now
+    static int core() noexcept
+    {
+#ifdef __3DS__
+        return svcGetProcessorID();
+#else
+        return sched_getcpu();
+#endif
+    }
+    static bool set_priority(int prio) noexcept
+    {
+#ifdef __3DS__
+        return R_SUCCEEDED(svcSetThreadPriority(CUR_THREAD_HANDLE, prio));
+#else
+        return apply_prio(gettid(), prio);
+#endif
     }
 };
 
-class thread {
+class thread : public thread_base {
 public:
     struct meta {
         std::size_t stack_size;
+        // see default_prio
         int prio;
+        // any_core, or a core id such as worker_core() gives
         int core_id;
     };
 
 private:
+#ifdef __3DS__
     Thread m_th{};
+#else
+    pthread_t m_th{};
+    bool m_running{false};
+    pid_t m_tid{};
+#endif
 
-    template<class P_t>
+    // owned by both sides of the start, so neither has to outlive the other
+    template<class Call>
+    struct start_block {
+        Call call;
+        int prio;
+        detail::start_latch started;
+#ifndef __3DS__
+        pid_t tid{};
+#endif
+    };
+
+    template<class Call>
+    static void run(std::shared_ptr<start_block<Call>>* v_arg)
+    {
+        auto block = std::move(*std::unique_ptr<std::shared_ptr<start_block<Call>>>(v_arg));
+#ifndef __3DS__
+        // threadCreate takes the priority, pthread_create doesn't for normal threads
+        block->tid = gettid();
+        apply_prio(block->tid, block->prio);
+#endif
+        Call call = std::move(block->call);
+        block->started.signal();
+        block.reset();
+        std::apply([](auto& func, auto&... args) { std::invoke(std::move(func), std::move(args)...); }, call);
+    }
+
+#ifdef __3DS__
+    template<class Call>
     static void trampoline(void* v_arg)
     {
-        auto const thread_arg = std::unique_ptr<P_t>(static_cast<P_t*>(v_arg));
-        std::apply(thread_arg->first, std::forward<typename P_t::second_type>(thread_arg->second));
+        run<Call>(static_cast<std::shared_ptr<start_block<Call>>*>(v_arg));
     }
+#else
+    template<class Call>
+    static void* trampoline(void* v_arg)
+    {
+        run<Call>(static_cast<std::shared_ptr<start_block<Call>>*>(v_arg));
+        return nullptr;
+    }
+#endif
 
 public:
     using id = thread_id;
 
     static constexpr inline meta basic_meta{
         64 * 1024,
-        0x30,
-        0,
+        default_prio,
+        any_core,
     };
 
+    // returns once the new thread is running, the function and arguments are copied like std::thread does
     template<class F, typename... Args>
     thread(const meta& info, F&& func, Args&&... args)
     {
-        static_assert(std::is_invocable_v<F, std::unwrap_reference_t<Args>...>, "Can not call this function with these argument.");
-        using P_t = std::pair<F&&, std::tuple<std::unwrap_reference_t<Args>...>>;
-        auto arg = std::make_unique<P_t>(
-            std::forward<F>(func),
-            std::forward_as_tuple(std::forward<Args>(args)...)
-        );
-        m_th = threadCreate(&thread::trampoline<P_t>, arg.get(), info.stack_size, info.prio, info.core_id, false);
-        if(m_th)
+        static_assert(std::is_invocable_v<std::decay_t<F>, std::decay_t<Args>...>, "Can not call this function with these argument.");
+        using Call = std::tuple<std::decay_t<F>, std::decay_t<Args>...>;
+        auto block = std::make_shared<start_block<Call>>(Call(std::forward<F>(func), std::forward<Args>(args)...), info.prio);
+        auto arg = std::make_unique<std::shared_ptr<start_block<Call>>>(block);
+
+#ifdef __3DS__
+        m_th = threadCreate(&thread::trampoline<Call>, arg.get(), info.stack_size, info.prio, info.core_id == any_core ? -2 : info.core_id, false);
+        const bool started = m_th != nullptr;
+#else
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, std::max<std::size_t>(info.stack_size, PTHREAD_STACK_MIN));
+        if(info.core_id != any_core)
+        {
+            cpu_set_t cores;
+            CPU_ZERO(&cores);
+            CPU_SET(info.core_id % CPU_SETSIZE, &cores);
+            pthread_attr_setaffinity_np(&attr, sizeof(cores), &cores);
+        }
+        m_running = pthread_create(&m_th, &attr, &thread::trampoline<Call>, arg.get()) == 0;
+        pthread_attr_destroy(&attr);
+        const bool started = m_running;
+#endif
+        if(started)
         {
-            svcSleepThread(1000 * 1000);
             arg.release();
+            block->started.wait();
+#ifndef __3DS__
+            m_tid = block->tid;
+#endif
         }
     }
 
@@ -129,9 +329,8 @@ public:
 
     thread() = default;
     thread(thread&& other)
-        : m_th(std::exchange(other.m_th, nullptr))
     {
-
+        swap(other);
     }
     thread(const thread&) = delete;
 
@@ -140,7 +339,7 @@ public:
         if(this != &other)
         {
             if(joinable()) throw std::runtime_error("Moving to a thread already running.");
-            m_th = std::exchange(other.m_th, nullptr);
+            swap(other);
         }
         return *this;
     }
@@ -148,20 +347,32 @@ public:
 
     ~thread()
     {
-        if(m_th)
+        if(*this)
         {
+#ifdef __3DS__
             svcBreak(USERBREAK_ASSERT);
+#else
+            std::terminate();
+#endif
         }
     }
 
     operator bool() const
     {
+#ifdef __3DS__
         return m_th != nullptr;
+#else
+        return m_running;
+#endif
     }
 
     bool joinable() const noexcept
     {
-        return m_th != threadGetCurrent();
+#ifdef __3DS__
+        return m_th != nullptr && m_th != threadGetCurrent();
+#else
+        return m_running && !pthread_equal(m_th, pthread_self());
+#endif
     }
 
     thread_id get_id()
@@ -170,34 +381,101 @@ public:
         out.m_id = m_th;
         return out;
     }
-    Thread native_handle() const
+    detail::native_thread native_handle() const
     {
         return m_th;
     }
-    void join_timeout(const u64 timeout)
+    void join_timeout(const std::uint64_t timeout)
     {
+#ifdef __3DS__
         if(R_SUCCEEDED(threadJoin(m_th, timeout)))
         {
             threadFree(m_th);
             m_th = nullptr;
         }
+#else
+        int err;
+        if(timeout == UINT64_MAX)
+        {
+            err = pthread_join(m_th, nullptr);
+        }
+        else
+        {
+            const timespec deadline = detail::deadline_after(CLOCK_REALTIME, std::chrono::nanoseconds(timeout));
+            err = pthread_timedjoin_np(m_th, nullptr, &deadline);
+        }
+        if(err == 0)
+        {
+            m_running = false;
+        }
+#endif
     }
-    
+
     void join()
     {
-        join_timeout(U64_MAX);
+        join_timeout(UINT64_MAX);
     }
     void swap(thread& other) noexcept
     {
         std::swap(m_th, other.m_th);
+#ifndef __3DS__
+        std::swap(m_running, other.m_running);
+        std::swap(m_tid, other.m_tid);
+#endif
+    }
+
+    // only the change of priority can happen after the start, 3DS threads stay on the core they were created for
+    bool set_priority(int prio) noexcept
+    {
+#ifdef __3DS__
+        return R_SUCCEEDED(svcSetThreadPriority(threadGetHandle(m_th), prio));
+#else
+        return m_running && apply_prio(m_tid, prio);
+#endif
     }
 
+    // cores an application can run threads on
     static unsigned int hardware_concurrency() noexcept
     {
-        return 1;
+#ifdef __3DS__
+        // the app core, the system core if a share of it was given with APT_SetAppCpuTimeLimit, and the New 3DS' third core
+        bool is_new = false;
+        APT_CheckNew3DS(&is_new);
+        u32 syscore_percent = 0;
+        APT_GetAppCpuTimeLimit(&syscore_percent);
+        return 1 + (syscore_percent ? 1 : 0) + (is_new ? 1 : 0);
+#else
+        cpu_set_t cores;
+        if(sched_getaffinity(0, sizeof(cores), &cores) == 0)
+        {
+            return CPU_COUNT(&cores);
+        }
+        const long online = sysconf(_SC_NPROCESSORS_ONLN);
+        return online > 0 ? online : 1;
+#endif
+    }
+
+    // for a thread that shouldn't take time from the main one: a core of its own where there is one
+    static int worker_core() noexcept
+    {
+#ifdef __3DS__
+        bool is_new = false;
+        APT_CheckNew3DS(&is_new);
+        if(is_new)
+        {
+            return 2;
+        }
+        u32 syscore_percent = 0;
+        APT_GetAppCpuTimeLimit(&syscore_percent);
+        return syscore_percent ? 1 : any_core;
+#else
+        // the scheduler already spreads threads over the cores, pinning would only get in its way
+        return any_core;
+#endif
     }
 };
 
+#ifdef __3DS__
 class mutex {
     LightLock m_lock;
 
@@ -261,31 +539,129 @@ public:
         return &m_lock;
     }
 };
+#else
+class mutex {
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+
+public:
+    mutex() noexcept = default;
+    ~mutex()
+    {
+        pthread_mutex_destroy(&m_lock);
+    }
+    mutex(const mutex&) = delete;
+    mutex& operator=(const mutex&) = delete;
+    mutex(mutex&&) = delete;
+    mutex& operator=(mutex&&) = delete;
+
+    void lock() noexcept
+    {
+        pthread_mutex_lock(&m_lock);
+    }
+    bool try_lock() noexcept
+    {
+        return pthread_mutex_trylock(&m_lock) == 0;
+    }
+    void unlock() noexcept
+    {
+        pthread_mutex_unlock(&m_lock);
+    }
+
+    pthread_mutex_t* native_handle()
+    {
+        return &m_lock;
+    }
+};
+
+class recursive_mutex {
+    pthread_mutex_t m_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+public:
+    recursive_mutex() noexcept = default;
+    ~recursive_mutex()
+    {
+        pthread_mutex_destroy(&m_lock);
+    }
+    recursive_mutex(const recursive_mutex&) = delete;
+    recursive_mutex& operator=(const recursive_mutex&) = delete;
+    recursive_mutex(recursive_mutex&&) = delete;
+    recursive_mutex& operator=(recursive_mutex&&) = delete;
+
+    void lock() noexcept
+    {
+        pthread_mutex_lock(&m_lock);
+    }
+    bool try_lock() noexcept
+    {
+        return pthread_mutex_trylock(&m_lock) == 0;
+    }
+    void unlock() noexcept
+    {
+        pthread_mutex_unlock(&m_lock);
+    }
+
+    pthread_mutex_t* native_handle()
+    {
+        return &m_lock;
+    }
+};
+#endif
 
 enum class cv_status { no_timeout, timeout };
 
 class condition_variable {
+#ifdef __3DS__
     CondVar m_cv;
+#else
+    pthread_cond_t m_cv;
+#endif
 
 public:
     condition_variable()
     {
+#ifdef __3DS__
         CondVar_Init(&m_cv);
+#else
+        // timeouts are measured on the monotonic clock, like steady_clock
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&m_cv, &attr);
+        pthread_condattr_destroy(&attr);
+#endif
+    }
+#ifndef __3DS__
+    ~condition_variable()
+    {
+        pthread_cond_destroy(&m_cv);
     }
+#endif
     condition_variable(const condition_variable&) = delete;
 
     void notify_one() noexcept
     {
+#ifdef __3DS__
         CondVar_Signal(&m_cv);
+#else
+        pthread_cond_signal(&m_cv);
+#endif
     }
     void notify_all() noexcept
     {
+#ifdef __3DS__
         CondVar_Broadcast(&m_cv);
+#else
+        pthread_cond_broadcast(&m_cv);
+#endif
     }
 
     void wait(std::unique_lock<mutex>& lock)
     {
+#ifdef __3DS__
         CondVar_Wait(&m_cv, lock.mutex()->native_handle());
+#else
+        pthread_cond_wait(&m_cv, lock.mutex()->native_handle());
+#endif
     }
     template< class Predicate >
     void wait( std::unique_lock<mutex>& lock, Predicate stop_waiting)
@@ -298,8 +674,15 @@ public:
     template<class Rep, class Period>
     cv_status wait_for(std::unique_lock<mutex>& lock, const std::chrono::duration<Rep, Period>& rel_time)
     {
-        const int r = CondVar_WaitTimeout(&m_cv, lock.mutex()->native_handle(), std::chrono::duration_cast<std::chrono::nanoseconds>(rel_time).count());
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(rel_time);
+#ifdef __3DS__
+        const int r = CondVar_WaitTimeout(&m_cv, lock.mutex()->native_handle(), ns.count());
         return r == 0 ? cv_status::no_timeout : cv_status::timeout;
+#else
+        const timespec deadline = detail::deadline_after(CLOCK_MONOTONIC, ns);
+        const int r = pthread_cond_timedwait(&m_cv, lock.mutex()->native_handle(), &deadline);
+        return r == ETIMEDOUT ? cv_status::timeout : cv_status::no_timeout;
+#endif
     }
 
     template< class Rep, class Period, class Predicate >
@@ -310,10 +693,10 @@ public:
         return wait_until(lock, std::chrono::steady_clock::now() + rel_time, std::move(stop_waiting));
     }
 
-    template<class Rep, class Period>
-    cv_status wait_until(std::unique_lock<mutex>& lock, const std::chrono::duration<Rep, Period>& abs_time)
+    template<class Clock, class Duration>
+    cv_status wait_until(std::unique_lock<mutex>& lock, const std::chrono::time_point<Clock, Duration>& abs_time)
     {
-        return wait_for(lock, abs_time - std::chrono::steady_clock::now());
+        return wait_for(lock, abs_time - Clock::now());
     }
 
     template< class Clock, class Duration, class Predicate >
@@ -331,7 +714,7 @@ public:
         return true;
     }
 
-    CondVar* native_handle()
+    auto native_handle()
     {
         return &m_cv;
     }
@@ -0,0 +1,50 @@
+#include "glyph_cache.h"
+
+glyph_cache::glyph_cache(render_backend& backend_arg)
+    : backend(backend_arg)
+{
+    ascii.fill(EMPTY);
+    // slot 0 is never drawn, keep a blank so indices line up
+    codepoints.push_back(' ');
+}
+
+glyph_cache::index glyph_cache::lookup(char32_t c)
+{
+    if(c <= ' ')
+        return EMPTY;
+
+    if(c < ascii.size())
+    {
+        auto& idx = ascii[c];
+        if(idx == EMPTY)
+            idx = insert(c);
+        return idx;
+    }
+
+    if(auto it = others.find(c); it != others.end())
+        return it->second;
+
+    const index idx = insert(c);
+    others.emplace(c, idx);
+    return idx;
+}
+char32_t glyph_cache::codepoint(index idx) const
+{
+    return codepoints[idx];
+}
+
+std::size_t glyph_cache::size() const
+{
+    return codepoints.size() - 1;
+}
+
+glyph_cache::index glyph_cache::insert(char32_t c)
+{
+    if(codepoints.size() == 0xffff)
+        return EMPTY;
+
+    const index idx = codepoints.size();
+    codepoints.push_back(c);
+    backend.load_glyph(idx, c);
+    return idx;
+}
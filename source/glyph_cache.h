@@ -0,0 +1,28 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <array>
+
+#include "render_backend.h"
+
+// hands out small stable indices per codepoint, the backend prepares each one once
+struct glyph_cache {
+    using index = glyph_index;
+    // blank cell, nothing to draw
+    static constexpr inline index EMPTY = 0;
+
+    glyph_cache(render_backend& backend_arg);
+
+    index lookup(char32_t c);
+    char32_t codepoint(index idx) const;
+    std::size_t size() const;
+
+private:
+    index insert(char32_t c);
+
+    render_backend& backend;
+    std::array<index, 128> ascii;
+    std::unordered_map<char32_t, index> others;
+    std::vector<char32_t> codepoints;
+};
@@ -0,0 +1,88 @@
+#include "headless_backend.h"
+#include <algorithm>
+
+headless_backend::headless_backend(float glyph_width_arg, float glyph_height_arg)
+    : glyph_width(glyph_width_arg)
+    , glyph_height(glyph_height_arg)
+{
+
+}
+
+void headless_backend::load_glyph(glyph_index idx, char32_t c)
+{
+    if(codepoints.size() <= idx)
+        codepoints.resize(idx + 1);
+    codepoints[idx] = c;
+    loads += 1;
+}
+void headless_backend::measure_glyph(glyph_index, float scale, float& width, float& height)
+{
+    width = glyph_width * scale;
+    height = glyph_height * scale;
+}
+
+void headless_backend::draw_rect(float x, float y, float z, float w, float h, u32 color)
+{
+    target().push_back({command::kind::rect, x, y, z, w, h, color, 0});
+}
+void headless_backend::draw_glyph(glyph_index idx, float x, float y, float z, float scale, u32 color)
+{
+    target().push_back({command::kind::glyph, x, y, z, glyph_width * scale, glyph_height * scale, color, codepoints[idx]});
+}
+
+void headless_backend::resize_row_cache(std::size_t slots, float width, float height, u32 clear_color)
+{
+    row_clear = clear_color;
+    rows.assign(slots, {});
+    row_width = width;
+    row_height = height;
+}
+bool headless_backend::begin_row(std::size_t slot)
+{
+    current_row = slot;
+    rows[slot].clear();
+    builds += 1;
+    return true;
+}
+void headless_backend::end_row()
+{
+    current_row = std::string::npos;
+}
+void headless_backend::draw_row(std::size_t slot, float x, float y, float z)
+{
+    recorded.push_back({command::kind::row, x, y, z, row_width, row_height, 0, char32_t(slot)});
+}
+
+const std::vector<headless_backend::command>& headless_backend::commands() const
+{
+    return recorded;
+}
+std::size_t headless_backend::count(command::kind type) const
+{
+    return std::count_if(recorded.begin(), recorded.end(), [type](const command& c) { return c.type == type; });
+}
+void headless_backend::clear_commands()
+{
+    recorded.clear();
+}
+std::size_t headless_backend::glyph_loads() const
+{
+    return loads;
+}
+const std::vector<headless_backend::command>& headless_backend::row_commands(std::size_t slot) const
+{
+    return rows[slot];
+}
+std::size_t headless_backend::row_builds() const
+{
+    return builds;
+}
+u32 headless_backend::row_clear_color() const
+{
+    return row_clear;
+}
+
+std::vector<headless_backend::command>& headless_backend::target()
+{
+    return current_row == std::string::npos ? recorded : rows[current_row];
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "render_backend.h"
+
+// draws nothing, keeps a list of what would have been drawn
+// lets the terminal run and be measured without a 3DS
+struct headless_backend : render_backend {
+    struct command {
+        enum class kind : u8 {
+            rect,
+            glyph,
+            // a cached row shown, codepoint holds the slot
+            row,
+        };
+        kind type;
+        float x, y, z, w, h;
+        u32 color;
+        char32_t codepoint;
+    };
+
+    // every glyph measures this much at scale 1
+    headless_backend(float glyph_width_arg = 10.0f, float glyph_height_arg = 15.0f);
+
+    void load_glyph(glyph_index idx, char32_t c) override;
+    void measure_glyph(glyph_index idx, float scale, float& width, float& height) override;
+
+    void draw_rect(float x, float y, float z, float w, float h, u32 color) override;
+    void draw_glyph(glyph_index idx, float x, float y, float z, float scale, u32 color) override;
+
+    void resize_row_cache(std::size_t slots, float width, float height, u32 clear_color) override;
+    bool begin_row(std::size_t slot) override;
+    void end_row() override;
+    void draw_row(std::size_t slot, float x, float y, float z) override;
+
+    // draw calls issued on screen, rows rebuilt into their slot are not counted here
+    const std::vector<command>& commands() const;
+    std::size_t count(command::kind type) const;
+    // call between frames, keeps the glyphs
+    void clear_commands();
+    std::size_t glyph_loads() const;
+    // what a slot currently holds, and how many times any slot was rebuilt
+    const std::vector<command>& row_commands(std::size_t slot) const;
+    std::size_t row_builds() const;
+    // what every slot starts out as
+    u32 row_clear_color() const;
+
+private:
+    std::vector<command>& target();
+
+    float glyph_width, glyph_height;
+    float row_width{0.0f}, row_height{0.0f};
+    u32 row_clear{0};
+    std::size_t loads{0};
+    std::vector<char32_t> codepoints;
+    std::vector<command> recorded;
+    std::vector<std::vector<command>> rows;
+    // slot being rebuilt, or npos
+    std::size_t current_row{std::string::npos};
+    std::size_t builds{0};
+};
@@ -0,0 +1,73 @@
+#include "heap_config.h"
+#include <string_view>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+
+static constexpr std::size_t KIB = 1024, MIB = 1024 * KIB;
+
+static std::string_view trim(std::string_view sv)
+{
+    while(!sv.empty() && (sv.front() == ' ' || sv.front() == '\t'))
+        sv.remove_prefix(1);
+    while(!sv.empty() && (sv.back() == ' ' || sv.back() == '\t' || sv.back() == '\r' || sv.back() == '\n'))
+        sv.remove_suffix(1);
+    return sv;
+}
+
+heap_config heap_config::load(const char* path, std::size_t free_memory)
+{
+    // an eighth of what's free to start with, up to half of it when growing; the rest is left to the app
+    heap_config conf{
+        std::clamp(free_memory / 8, 1 * MIB, 8 * MIB),
+        0,
+        80 * KIB,
+        256 * KIB,
+        0,
+        0,
+    };
+    conf.heap_max = std::max(free_memory / 2, conf.heap_size);
+
+    if(FILE* f = fopen(path, "r"))
+    {
+        char line_buf[128];
+        while(fgets(line_buf, sizeof(line_buf), f))
+        {
+            std::string_view line(line_buf);
+            line = trim(line.substr(0, line.find('#')));
+            const auto eq = line.find('=');
+            if(eq == std::string_view::npos)
+                continue;
+
+            const auto key = trim(line.substr(0, eq));
+            const auto value = trim(line.substr(eq + 1));
+            std::size_t number = 0;
+            const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), number);
+            if(ec != std::errc{} || end != value.data() + value.size() || !number)
+            {
+                fprintf(stderr, "%s: ignoring '%.*s'\n", path, int(line.size()), line.data());
+                continue;
+            }
+
+            if(key == "heap_kb")
+                conf.heap_size = number * KIB;
+            else if(key == "heap_max_kb")
+                conf.heap_max = number * KIB;
+            else if(key == "stack_kb")
+                conf.stack_size = number * KIB;
+            else if(key == "exec_kb")
+                conf.exec_size = number * KIB;
+            else if(key == "time_limit_ms")
+                conf.time_limit_ms = std::min<std::size_t>(number, UINT32_MAX);
+            else if(key == "vm_tick_limit")
+                conf.vm_tick_limit = std::min<std::size_t>(number, UINT32_MAX);
+            else
+                fprintf(stderr, "%s: unknown key '%.*s'\n", path, int(key.size()), key.data());
+        }
+        fclose(f);
+    }
+
+    conf.heap_max = std::max(conf.heap_max, conf.heap_size);
+    conf.stack_size = std::max(conf.stack_size, 16 * KIB);
+    return conf;
+}
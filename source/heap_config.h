@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// how much memory and time the python thread gets
+struct heap_config {
+    // first GC heap area
+    std::size_t heap_size;
+    // the GC heap grows in more areas up to this total, heap_size means it never grows
+    std::size_t heap_max;
+    std::size_t stack_size;
+    // executable region for native and viper code
+    std::size_t exec_size;
+    // budget of each REPL line or script before it gets a TimeoutError, 0 = no limit; see port_budget.h
+    std::uint32_t time_limit_ms;
+    std::uint32_t vm_tick_limit;
+
+    /*
+     * lines of "key = value", # starts a comment:
+     *   heap_kb, heap_max_kb, stack_kb, exec_kb, time_limit_ms, vm_tick_limit
+     * anything missing, or the whole file, defaults to a share of free_memory
+     */
+    static heap_config load(const char* path, std::size_t free_memory);
+};
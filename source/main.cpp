@@ -22,6 +22,8 @@
 int main(int argc, char **argv)
 {
     gfxInitDefault();
+    // lets threads run on the system core too, see ctr::thread::worker_core
+    APT_SetAppCpuTimeLimit(30);
     C3D_Init(C3D_DEFAULT_CMDBUF_SIZE);
     C2D_Init(C2D_DEFAULT_MAX_OBJECTS);
     C2D_Prepare();
@@ -36,7 +38,7 @@ int main(int argc, char **argv)
     C2D_SpriteSheet sprites = C2D_SpriteSheetLoad("romfs:/gfx/sprites.t3x");
     int retval = 0;
     {
-    auto app_ptr = std::make_unique<application>(mono_font, sprites);
+    auto app_ptr = std::make_unique<application>(mono_font, sprites, top);
     auto& app = *app_ptr;
 
     touchPosition touch;
@@ -50,7 +52,8 @@ int main(int argc, char **argv)
         const u32 kHeld = hidKeysHeld();
         const u32 kUp = hidKeysUp();
 
-        app.read_output(10);
+        // a quarter of a frame for printing, more when output piles up
+        app.read_output(4000);
 
         if(kDown & KEY_START)
         {
@@ -81,6 +84,25 @@ int main(int argc, char **argv)
             app.press_key("\e[C", !(kDownRepeat & ~kDown & KEY_DRIGHT));
         }
 
+        if(kDown & KEY_SELECT)
+        {
+            app.toggle_gc_overlay();
+        }
+        // X and Y together, whichever went down last
+        if((kHeld & (KEY_X | KEY_Y)) == (KEY_X | KEY_Y) && (kDown & (KEY_X | KEY_Y)))
+        {
+            app.toggle_profiler();
+        }
+
+        if(kDownRepeat & KEY_L)
+        {
+            app.page_output(true);
+        }
+        else if(kDownRepeat & KEY_R)
+        {
+            app.page_output(false);
+        }
+
         if(kHeld & KEY_TOUCH)
         {
             hidTouchRead(&touch);
@@ -98,11 +120,18 @@ int main(int argc, char **argv)
             app.click_release();
         }
 
+        // frames are skipped while a large backlog of output gets parsed, the loop then runs without vsync
+        // and frame_due sleeps a little instead, so the python thread can go on printing
+        if(!app.frame_due())
+        {
+            continue;
+        }
+
         app.tick();
 
         C3D_FrameBegin(C3D_FRAME_SYNCDRAW);
 
-        C2D_TargetClear(top, C2D_Color32(0,0,0,255));
+        C2D_TargetClear(top, screen::CLEAR_COLOR);
         C2D_TargetClear(bottom, C2D_Color32(0,0,0,255));
 
         C2D_SceneBegin(top);
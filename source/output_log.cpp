@@ -0,0 +1,151 @@
+#include "output_log.h"
+#include <algorithm>
+
+output_log::output_log(const settings& conf_arg)
+    : conf(conf_arg)
+{
+    if(!open_file())
+        return;
+    enabled = true;
+
+    filling.reserve(conf.buffer_size);
+    writing.reserve(conf.buffer_size);
+
+    ctr::thread::meta meta = ctr::thread::basic_meta;
+    meta.stack_size = 16 * 1024;
+    // below the UI and python threads, and off their core when there is a spare one
+    meta.prio += 2;
+    meta.core_id = ctr::thread::worker_core();
+    self_thread = ctr::thread(meta, &output_log::loop_func, this);
+}
+output_log::~output_log()
+{
+    if(!enabled)
+        return;
+
+    {
+    std::unique_lock lk(mut);
+    stopping = true;
+    }
+    wake.notify_one();
+    self_thread.join();
+    if(file)
+        fclose(file);
+}
+
+bool output_log::is_open() const
+{
+    return enabled;
+}
+void output_log::append(std::string_view str)
+{
+    if(!enabled)
+        return;
+
+    bool half_full;
+    {
+    std::unique_lock lk(mut);
+    const auto fits = std::min(str.size(), conf.buffer_size - filling.size());
+    filling.append(str.substr(0, fits));
+    totals.bytes_dropped += str.size() - fits;
+    totals.peak_buffered = std::max(totals.peak_buffered, filling.size());
+    half_full = filling.size() >= conf.buffer_size / 2;
+    }
+    if(half_full)
+        wake.notify_one();
+}
+output_log::counters output_log::stats() const
+{
+    std::unique_lock lk(mut);
+    return totals;
+}
+
+bool output_log::open_file()
+{
+    file = fopen(conf.path.c_str(), "ab");
+    if(!file)
+        return false;
+    fseek(file, 0, SEEK_END);
+    file_size = ftell(file);
+    return true;
+}
+void output_log::rotate()
+{
+    fclose(file);
+    file = nullptr;
+
+    const auto numbered = [this](unsigned n) {
+        return conf.path + "." + std::to_string(n);
+    };
+    if(conf.keep_files)
+    {
+        remove(numbered(conf.keep_files).c_str());
+        for(unsigned n = conf.keep_files; n > 1; --n)
+        {
+            rename(numbered(n - 1).c_str(), numbered(n).c_str());
+        }
+        rename(conf.path.c_str(), numbered(1).c_str());
+    }
+    else
+    {
+        remove(conf.path.c_str());
+    }
+    open_file();
+}
+void output_log::write_out()
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::string_view left(writing);
+    u64 written = 0, rotations = 0;
+    while(!left.empty() && file)
+    {
+        if(file_size >= conf.rotate_size)
+        {
+            rotate();
+            rotations += 1;
+            if(!file)
+                break;
+        }
+        const auto chunk = std::min(left.size(), conf.rotate_size - file_size);
+        const auto done = fwrite(left.data(), 1, chunk, file);
+        file_size += done;
+        written += done;
+        left.remove_prefix(chunk);
+        if(done != chunk)
+            break;
+    }
+    if(file)
+        fflush(file);
+    const auto taken = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    std::unique_lock lk(mut);
+    totals.bytes_written += written;
+    totals.bytes_dropped += writing.size() - written;
+    totals.writes += 1;
+    totals.rotations += rotations;
+    totals.write_us += taken.count();
+}
+void output_log::loop_func()
+{
+    while(true)
+    {
+        bool last;
+        {
+        std::unique_lock lk(mut);
+        wake.wait_for(lk, conf.flush_interval, [this]() {
+            return stopping || filling.size() >= conf.buffer_size / 2;
+        });
+        last = stopping;
+        std::swap(filling, writing);
+        filling.clear();
+        }
+
+        if(!writing.empty())
+        {
+            write_out();
+            writing.clear();
+        }
+        if(last)
+            break;
+    }
+}
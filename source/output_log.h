@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string_view>
+#include <string>
+#include <chrono>
+#include <cstdio>
+
+#include "platform.h"
+#include "ctr_thread.h"
+
+// copy of the output in a file, written from its own thread so a slow card never holds up the caller
+struct output_log {
+    struct settings {
+        // older files get .1, .2, ... appended, .1 being the most recent
+        std::string path;
+        // output is batched in two buffers this big, one filling while the other gets written
+        std::size_t buffer_size{32 * 1024};
+        // a file this big is rotated out
+        std::size_t rotate_size{1024 * 1024};
+        unsigned keep_files{3};
+        std::chrono::milliseconds flush_interval{2000};
+    };
+    struct counters {
+        u64 bytes_written, bytes_dropped;
+        u64 writes, rotations;
+        u64 write_us;
+        std::size_t peak_buffered;
+    };
+
+    explicit output_log(const settings& conf_arg);
+    ~output_log();
+
+    // false if the file couldn't be opened, append() then does nothing
+    bool is_open() const;
+    // never waits for the file, what doesn't fit while the writer is behind is dropped and counted
+    void append(std::string_view str);
+    counters stats() const;
+
+private:
+    settings conf;
+    // only the writer thread touches the file once it runs
+    FILE* file{nullptr};
+    bool enabled{false};
+    std::size_t file_size{0};
+
+    mutable ctr::mutex mut;
+    ctr::condition_variable wake;
+    std::string filling, writing;
+    bool stopping{false};
+    counters totals{};
+
+    ctr::thread self_thread;
+
+    bool open_file();
+    void rotate();
+    void write_out();
+    void loop_func();
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+// the terminal engine only needs libctru's integer types and console flags from it,
+// so that it can also be built and measured on the host
+#ifdef __3DS__
+#include <3ds.h>
+#else
+#include <cstdint>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+// same values as libctru's console.h
+#define CONSOLE_COLOR_BOLD    (1<<0)
+#define CONSOLE_COLOR_FAINT   (1<<1)
+#define CONSOLE_ITALIC        (1<<2)
+#define CONSOLE_UNDERLINE     (1<<3)
+#define CONSOLE_BLINK_SLOW    (1<<4)
+#define CONSOLE_BLINK_FAST    (1<<5)
+#define CONSOLE_COLOR_REVERSE (1<<6)
+#define CONSOLE_CONCEAL       (1<<7)
+#define CONSOLE_CROSSED_OUT   (1<<8)
+#endif
@@ -1,5 +1,7 @@
 #include "python_handler.h"
 #include "printer.h"
+#include <algorithm>
+#include <cstring>
 
 extern "C" {
 #include "py/builtin.h"
@@ -11,8 +13,15 @@ extern "C" {
 #include "py/stackctrl.h"
 #include "py/mperrno.h"
 #include "py/nlr.h"
+#include "py/mpthread.h"
 #include "extmod/vfs.h"
 #include "extmod/vfs_posix.h"
+#include "port_heap.h"
+#include "port_exec.h"
+#include "port_event.h"
+#include "port_budget.h"
+#include "port_prof.h"
+#include "vfs_mpycache.h"
 }
 
 #define FORCED_EXIT (0x100)
@@ -46,18 +55,36 @@ static int do_run(T&& callback)
     }
 }
 
-python_handler::python_handler(std::span<std::string_view> import_search_paths_arg)
+python_handler::python_handler(std::span<std::string_view> import_search_paths_arg, const output_log::settings& log_settings, const heap_config& memory_arg)
     : import_search_paths(import_search_paths_arg)
+    , memory(memory_arg)
 {
+    if(!log_settings.path.empty())
+    {
+        log = std::make_unique<output_log>(log_settings);
+        if(!log->is_open())
+            log.reset();
+    }
+
     LightEvent_Init(&stop_event, RESET_ONESHOT);
     LightEvent_Init(&new_event, RESET_ONESHOT);
+    LightEvent_Init(&space_event, RESET_ONESHOT);
+    mp_port_event_init();
+    mp_port_prof_init();
     line_done = false;
 
     Printer::payload = this;
     Printer::callback = &python_handler::print_callback;
 
+    set_run_limits(memory.time_limit_ms, memory.vm_tick_limit);
+    ctr::thread::meta monitor_meta = ctr::thread::basic_meta;
+    monitor_meta.stack_size = 16 * 1024;
+    // above the python thread, or a busy loop would keep it from firing
+    monitor_meta.prio -= 1;
+    monitor_thread = ctr::thread(monitor_meta, &python_handler::monitor_func, this);
+
     ctr::thread::meta meta = ctr::thread::basic_meta;
-    meta.stack_size = 80 * 1024;
+    meta.stack_size = memory.stack_size;
     meta.prio += 1;
     self_thread = ctr::thread(meta, &python_handler::loop_func, this);
 }
@@ -66,21 +93,100 @@ python_handler::~python_handler()
 {
     signal_stop();
     self_thread.join();
+
+    {
+    std::unique_lock lk(run_mut);
+    monitor_stopping = true;
+    }
+    run_cv.notify_one();
+    monitor_thread.join();
+}
+
+int python_handler::read(std::string_view& into)
+{
+    // checked before the ring, everything printed before it was set is in there by then
+    const bool done = line_done;
+    into = out_ring.readable();
+    if(into.empty())
+    {
+        return done ? 0 : -1;
+    }
+    return 1;
+}
+void python_handler::consume(std::size_t count)
+{
+    out_ring.consume(count);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(out_ring.size() <= low_water && writers_waiting != 0)
+    {
+        LightEvent_Signal(&space_event);
+    }
+}
+
+std::size_t python_handler::pending_output() const
+{
+    return out_ring.size();
+}
+
+void python_handler::set_output_limits(std::size_t high_water_arg, std::size_t low_water_arg, overflow_policy policy_arg)
+{
+    const auto high = std::clamp<std::size_t>(high_water_arg, 1, out_ring.capacity());
+    low_water = std::min(low_water_arg, high - 1);
+    high_water = high;
+    policy = policy_arg;
+}
+python_handler::output_counters python_handler::output_stats() const
+{
+    return {
+        out_ring.size(), peak_depth,
+        bytes_written, bytes_dropped,
+        stalls, stall_ticks / (SYSCLOCK_ARM11 / 1000000),
+    };
+}
+std::optional<output_log::counters> python_handler::log_stats() const
+{
+    if(!log)
+        return std::nullopt;
+    return log->stats();
 }
 
-int python_handler::read(std::string& into)
+void python_handler::set_run_limits(std::uint32_t time_limit_ms_arg, std::uint32_t vm_tick_limit_arg)
+{
+    time_limit_ms = time_limit_ms_arg;
+    vm_tick_limit = vm_tick_limit_arg;
+}
+std::optional<python_handler::run_report> python_handler::last_run() const
 {
-    std::unique_lock lk(out_queue_mut);
-    if(out_text.empty())
+    std::unique_lock lk(run_mut);
+    return last_report;
+}
+
+bool python_handler::toggle_profiler()
+{
+    if(!mp_port_prof_running())
     {
-        return line_done ? 0 : -1;
+        const int err = mp_port_prof_start(MP_PORT_PROF_DEFAULT_INTERVAL_US, nullptr);
+        if(err != 0)
+        {
+            fprintf(stderr, "profiler: %s\n", strerror(err));
+        }
+        return err == 0;
     }
-    else
+
+    // the file gets written by the profiler's own thread, the UI doesn't wait for the SD card
+    if(mp_port_prof_stop() == 0)
     {
-        into = std::move(out_text.front());
-        out_text.pop();
-        return 1;
+        fprintf(stderr, "profiler: stopped, writing the folded stacks\n");
     }
+    return false;
+}
+bool python_handler::profiling() const
+{
+    return mp_port_prof_running();
+}
+void python_handler::set_profile_path(const std::string& path)
+{
+    mp_port_prof_set_default_path(path.c_str());
 }
 
 std::optional<int> python_handler::should_exit() const
@@ -90,6 +196,9 @@ std::optional<int> python_handler::should_exit() const
 
 void python_handler::signal_stop()
 {
+    // output nobody will read anymore mustn't keep the loop blocked
+    stopping = true;
+    LightEvent_Signal(&space_event);
     // stops the loop
     LightEvent_Signal(&stop_event);
     // starts a new iteration to notice the loop should stop
@@ -100,12 +209,77 @@ void python_handler::signal_stop()
 void python_handler::signal_interrupt()
 {
     mp_sched_keyboard_interrupt();
+    // ends a wait in the poll hook or a sleep right away
+    mp_port_event_signal();
 }
 
 void python_handler::handle_print(std::string_view str)
 {
-    std::unique_lock lk(out_queue_mut);
-    out_text.emplace(str);
+    // out_ring takes one producer: python threads only print holding the GIL, and while one of them waits
+    // for space with the GIL released, this lock keeps the others from writing at the same time
+    std::unique_lock lk(producer_mut);
+
+    // the log keeps everything, even what the screen drops
+    if(log && !str.empty())
+    {
+        log->append(str);
+        log_mid_line = str.back() != '\n';
+    }
+
+    if(dropping && out_ring.size() > low_water)
+    {
+        bytes_dropped += str.size();
+        return;
+    }
+    dropping = false;
+
+    while(true)
+    {
+        // an upper bound from this side, so high_water is never overshot
+        const std::size_t depth = out_ring.size();
+        const std::size_t room = high_water > depth ? high_water - depth : 0;
+        const std::size_t written = out_ring.write(str.substr(0, room));
+        str.remove_prefix(written);
+        bytes_written += written;
+        if(depth + written > peak_depth)
+        {
+            peak_depth = depth + written;
+        }
+        if(str.empty() || stopping)
+        {
+            break;
+        }
+
+        if(policy == overflow_policy::drop)
+        {
+            bytes_dropped += str.size();
+            dropping = true;
+            break;
+        }
+
+        // at high water, wait for the UI to read down to low water; the fence pairs with the one in consume()
+        writers_waiting += 1;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(out_ring.size() > low_water && !stopping)
+        {
+            const u64 wait_start = svcGetSystemTick();
+            // other python threads run meanwhile, a printing one gets the ring until its own wait
+            lk.unlock();
+            MP_THREAD_GIL_EXIT();
+            mp_port_idle_begin();
+            LightEvent_Wait(&space_event);
+            mp_port_idle_end();
+            MP_THREAD_GIL_ENTER();
+            lk.lock();
+            stalls += 1;
+            stall_ticks += svcGetSystemTick() - wait_start;
+        }
+        // the event wakes one waiter at a time, the next one gets woken while there's still room
+        if(--writers_waiting != 0 && out_ring.size() <= low_water)
+        {
+            LightEvent_Signal(&space_event);
+        }
+    }
 }
 
 void python_handler::print_callback(void* handler, std::string_view str)
@@ -114,21 +288,120 @@ void python_handler::print_callback(void* handler, std::string_view str)
     py_handler->handle_print(str);
 }
 
+void python_handler::begin_run()
+{
+    mp_port_budget_arm(vm_tick_limit);
+    run_cpu_start = mp_port_cpu_time_us();
+    {
+    std::unique_lock lk(run_mut);
+    run_start = std::chrono::steady_clock::now();
+    run_limit = std::chrono::milliseconds(time_limit_ms.load());
+    run_deadline = run_start + run_limit;
+    run_active = true;
+    }
+    run_cv.notify_one();
+}
+
+void python_handler::end_run(int result)
+{
+    const u64 cpu_us = mp_port_cpu_time_us() - run_cpu_start;
+    run_report report;
+    {
+    std::unique_lock lk(run_mut);
+    run_active = false;
+    report.wall_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - run_start).count();
+    }
+    // the monitor can't fire anymore, a TimeoutError it left pending is dropped here
+    report.vm_ticks = mp_port_budget_disarm();
+    report.cpu_us = cpu_us;
+    report.over_budget = mp_port_budget_expired();
+
+    if(log)
+    {
+        std::unique_lock producer_lk(producer_mut);
+        const char* status = report.over_budget ? "over budget" : result == 0 ? "ok" : result > 0 ? "exit" : "error";
+        char line[160];
+        const int len = snprintf(line, sizeof(line), "%s# %s: wall %llu.%03llu ms, cpu %llu.%03llu ms, %llu vm ticks\n",
+            log_mid_line ? "\n" : "", status,
+            (unsigned long long)(report.wall_us / 1000), (unsigned long long)(report.wall_us % 1000),
+            (unsigned long long)(report.cpu_us / 1000), (unsigned long long)(report.cpu_us % 1000),
+            (unsigned long long)report.vm_ticks);
+        log->append(std::string_view(line, std::min<std::size_t>(len, sizeof(line) - 1)));
+        log_mid_line = false;
+    }
+
+    std::unique_lock lk(run_mut);
+    last_report = report;
+}
+
+void python_handler::monitor_func()
+{
+    std::unique_lock lk(run_mut);
+    while(!monitor_stopping)
+    {
+        if(!run_active || run_limit.count() == 0)
+        {
+            run_cv.wait(lk);
+        }
+        else if(std::chrono::steady_clock::now() < run_deadline)
+        {
+            run_cv.wait_until(lk, run_deadline);
+        }
+        else
+        {
+            mp_port_budget_expire_time();
+            // again one budget later, if the TimeoutError got caught and the code went on
+            run_deadline += run_limit;
+        }
+    }
+}
+
 void python_handler::loop_func()
 {
-    const std::size_t heap_size = 1 << 20, stack_size = 40960;
-    auto heap_holder = std::make_unique<char[]>(heap_size);
+    // settle for less than asked rather than not starting at all
+    std::size_t heap_size = memory.heap_size;
+    std::unique_ptr<char[]> heap_holder;
+    while(!(heap_holder = std::unique_ptr<char[]>(new(std::nothrow) char[heap_size])) && heap_size > 64 * 1024)
+    {
+        heap_size /= 2;
+    }
+    if(!heap_holder)
+    {
+        fprintf(stderr, "gc heap: not even %zu KiB free\n", heap_size / 1024);
+        Printer::print("\e[31mnot enough memory to start python\e[0m\n");
+        // nothing can run, lines sent anyway are answered as done
+        line_done = true;
+        while(true)
+        {
+            LightEvent_Wait(&new_event);
+            if(LightEvent_TryWait(&stop_event))
+            {
+                return;
+            }
+            {
+            std::unique_lock lk(in_queue_mut);
+            in_text = {};
+            }
+            line_done = true;
+        }
+    }
+    fprintf(stderr, "gc heap: %zu KiB, may grow to %zu KiB\n", heap_size / 1024, memory.heap_max / 1024);
 
     mp_thread_init();
     mp_stack_ctrl_init();
-    mp_stack_set_limit(stack_size - 1024);
+    mp_stack_set_limit(memory.stack_size - 4096);
+    mp_port_heap_init(heap_size, memory.heap_max);
     gc_init(heap_holder.get(), heap_holder.get() + heap_size);
+    if(mp_port_exec_init(memory.exec_size))
+    {
+        fprintf(stderr, "native code: %zu KiB\n", mp_port_exec_size() / 1024);
+    }
 
     mp_init();
 
-    // Mount the host FS at the root of our internal VFS
+    // Mount the host FS at the root of our internal VFS, imports through it keep compiled .mpy next to their source
     mp_obj_t args[2] = {
-        MP_OBJ_TYPE_GET_SLOT(&mp_type_vfs_posix, make_new)(&mp_type_vfs_posix, 0, 0, NULL),
+        mp_vfs_mpycache_new(MP_OBJ_TYPE_GET_SLOT(&mp_type_vfs_posix, make_new)(&mp_type_vfs_posix, 0, 0, NULL)),
         MP_OBJ_NEW_QSTR(MP_QSTR__slash_),
     };
     mp_vfs_mount(2, args, (mp_map_t *)&mp_const_empty_map);
@@ -172,7 +445,9 @@ void python_handler::loop_func()
                 mp_lexer_t *lex = mp_lexer_new_from_str_len(MP_QSTR__lt_stdin_gt_, line.c_str(), line.size(), 0);
                 mp_parse_compile_execute(lex, MP_PARSE_SINGLE_INPUT, repl_globals, repl_locals);
             };
+            begin_run();
             const int r = line.front() == '\0' ? do_run(run_file_callback) : do_run(run_line_callback);
+            end_run(r);
             if(r > 0 && r & FORCED_EXIT)
             {
                 should_exit_opt = r & 0xff;
@@ -181,6 +456,17 @@ void python_handler::loop_func()
         line_done = true;
     }
 
+    // the stacks name strings that go away with the heap
+    mp_port_prof_stop();
+    mp_port_prof_stats_t stats;
+    if(const int err = mp_port_prof_wait(&stats); err != EINVAL)
+    {
+        fprintf(stderr, "profiler: %lu samples, %lu ticks, %lu stacks, %lu dropped%s%s\n",
+            (unsigned long)stats.samples, (unsigned long)stats.ticks, (unsigned long)stats.stacks, (unsigned long)stats.dropped,
+            err ? ", not written: " : "", err ? strerror(err) : "");
+    }
     mp_thread_deinit();
     mp_deinit();
+    mp_port_heap_free_all();
+    mp_port_exec_reset();
 }
@@ -6,12 +6,43 @@
 #include <atomic>
 #include <queue>
 #include <span>
+#include <chrono>
+#include <cstdint>
 
+#ifdef __3DS__
 #include <3ds.h>
+#else
+#include "ctr_host.h"
+#endif
 #include "ctr_thread.h"
+#include "byte_ring.h"
+#include "output_log.h"
+#include "heap_config.h"
 
 struct python_handler {
-    python_handler(std::span<std::string_view> import_search_paths);
+    // what printing does once high_water bytes are waiting to be read
+    enum class overflow_policy : u8 {
+        // the python thread waits until the UI has read down to low_water
+        block,
+        // output is thrown away and counted until the UI has read down to low_water
+        drop,
+    };
+    struct output_counters {
+        std::size_t depth, peak_depth;
+        u64 bytes_written, bytes_dropped;
+        u64 stalls, stall_us;
+    };
+    // what one REPL line or script cost
+    struct run_report {
+        u64 wall_us, cpu_us;
+        // jumps and calls the bytecode went through
+        u64 vm_ticks;
+        // a budget ran out and TimeoutError was raised
+        bool over_budget;
+    };
+
+    // output also goes to the log described by log_settings, if its path is set and can be opened
+    python_handler(std::span<std::string_view> import_search_paths, const output_log::settings& log_settings, const heap_config& memory_arg);
     ~python_handler();
 
     template<typename T>
@@ -24,11 +55,30 @@ struct python_handler {
     }
 
     /*
-     * 1 = read a string
+     * 1 = into holds output, valid until consume() is called with how much of it was used
      * 0 = nothing to read, finished
      * -1 = nothing to read, calculating
      */
-    int read(std::string& into);
+    int read(std::string_view& into);
+    void consume(std::size_t count);
+    // bytes waiting to be read, for the UI thread; at least this many while python prints
+    std::size_t pending_output() const;
+
+    // high_water is capped to what the output buffer holds, low_water to below high_water
+    void set_output_limits(std::size_t high_water, std::size_t low_water, overflow_policy policy);
+    output_counters output_stats() const;
+    std::optional<output_log::counters> log_stats() const;
+
+    // from the next submission on, 0 = no limit; starts out with what heap_config said
+    void set_run_limits(std::uint32_t time_limit_ms, std::uint32_t vm_tick_limit);
+    // the submission that finished last, also written to the log after its output
+    std::optional<run_report> last_run() const;
+
+    // the sampling profiler of port_prof.h, also reachable from python as the profiler module;
+    // stopping has a thread of its own write the folded stacks to the profile path, returns whether it's running now
+    bool toggle_profiler();
+    bool profiling() const;
+    void set_profile_path(const std::string& path);
 
     // exit code when SystemExit raised
     std::optional<int> should_exit() const;
@@ -38,17 +88,49 @@ struct python_handler {
 
 private:
     ctr::thread self_thread;
+    static constexpr inline std::size_t OUTPUT_RING_SIZE = 64 * 1024;
+
     std::queue<std::string> in_text;
-    std::queue<std::string> out_text;
     ctr::mutex in_queue_mut;
-    ctr::mutex out_queue_mut;
-    LightEvent stop_event, new_event;
+    // python thread writes, UI thread reads
+    byte_ring out_ring{OUTPUT_RING_SIZE};
+    std::atomic<std::size_t> high_water{OUTPUT_RING_SIZE}, low_water{OUTPUT_RING_SIZE / 2};
+    std::atomic<overflow_policy> policy{overflow_policy::block};
+    // python threads waiting for out_ring to go down to low_water
+    std::atomic<unsigned> writers_waiting{0};
+    // held while writing out_ring and the log, never while waiting, see handle_print
+    ctr::mutex producer_mut;
+    // under producer_mut: dropping until the ring goes down to low_water
+    bool dropping{false};
+    std::atomic<std::size_t> peak_depth{0};
+    std::atomic<u64> bytes_written{0}, bytes_dropped{0}, stalls{0}, stall_ticks{0};
+    std::atomic_bool stopping{false};
+    LightEvent stop_event, new_event, space_event;
+    std::unique_ptr<output_log> log;
+    // under producer_mut: the log doesn't end in a newline, the next run report starts a line
+    bool log_mid_line{false};
+
+    // the watchdog raising TimeoutError in the python thread once run_deadline passes
+    ctr::thread monitor_thread;
+    mutable ctr::mutex run_mut;
+    ctr::condition_variable run_cv;
+    bool run_active{false}, monitor_stopping{false};
+    std::chrono::steady_clock::time_point run_start, run_deadline;
+    std::chrono::milliseconds run_limit{0};
+    std::optional<run_report> last_report;
+    std::atomic<std::uint32_t> time_limit_ms{0}, vm_tick_limit{0};
+    // only touched by the python thread
+    u64 run_cpu_start{0};
     std::optional<int> should_exit_opt;
     std::span<std::string_view> import_search_paths;
+    heap_config memory;
 
     void signal_stop();
     void handle_print(std::string_view str);
     static void print_callback(void* handler, std::string_view str);
 
+    void begin_run();
+    void end_run(int result);
+    void monitor_func();
     void loop_func();
 };
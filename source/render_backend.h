@@ -0,0 +1,32 @@
+#pragma once
+
+#include "platform.h"
+
+using glyph_index = u16;
+
+// same layout as C2D_Color32
+static inline constexpr u32 color32(u8 r, u8 g, u8 b, u8 a)
+{
+    return r | (g << 8) | (b << 16) | (u32(a) << 24);
+}
+
+// everything screen needs to put pixels somewhere
+struct render_backend {
+    virtual ~render_backend() = default;
+
+    // called once per glyph index, the first time its codepoint is seen
+    virtual void load_glyph(glyph_index idx, char32_t c) = 0;
+    virtual void measure_glyph(glyph_index idx, float scale, float& width, float& height) = 0;
+
+    virtual void draw_rect(float x, float y, float z, float w, float h, u32 color) = 0;
+    virtual void draw_glyph(glyph_index idx, float x, float y, float z, float scale, u32 color) = 0;
+
+    // cached rows: drawn once into a slot, then shown again for a single draw call until their content changes
+    // drops every slot, each is width x height and starts out opaque clear_color, so the antialiased edges of what's
+    // drawn into it are blended once there and not again when the row is shown
+    virtual void resize_row_cache(std::size_t slots, float width, float height, u32 clear_color) = 0;
+    // draws until end_row go into the slot, relative to its top left; false means no cache, draw in place instead
+    virtual bool begin_row(std::size_t slot) = 0;
+    virtual void end_row() = 0;
+    virtual void draw_row(std::size_t slot, float x, float y, float z) = 0;
+};
@@ -1,31 +1,41 @@
 #include "screen.h"
 #include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstdio>
 
 static constexpr unsigned DEFAULT_BG_IDX = 0;
 static constexpr unsigned DEFAULT_FG_IDX = 7;
 static constexpr unsigned DEFAULT_FLAGS = CONSOLE_BLINK_SLOW;
 
-screen::screen(C2D_Font fnt_arg)
-    : fnt(fnt_arg)
+void screen::cell_grid::resize(std::size_t rows_arg, std::size_t cols_arg)
+{
+    width = cols_arg;
+    const auto count = rows_arg * cols_arg;
+    glyph.assign(count, glyph_cache::EMPTY);
+    fg.assign(count, DEFAULT_FG_IDX);
+    bg.assign(count, DEFAULT_BG_IDX);
+    attrs.assign(count, 0);
+}
+std::size_t screen::cell_grid::memory_usage() const
+{
+    return glyph.capacity() * sizeof(glyph_cache::index)
+        + fg.capacity() + bg.capacity() + attrs.capacity();
+}
+
+screen::screen(render_backend& backend_arg, std::size_t scrollback_depth)
+    : backend(backend_arg)
+    , history(scrollback_depth)
+    , glyphs(backend_arg)
     , output_width(400)
     , output_height(240)
 {
     flags = DEFAULT_FLAGS;
-    bg = FIXED_COLOR_TABLE[DEFAULT_BG_IDX];
-    fg = FIXED_COLOR_TABLE[DEFAULT_FG_IDX];
+    set_bg(DEFAULT_BG_IDX);
+    set_fg(DEFAULT_FG_IDX);
 
-    size_tbuf = C2D_TextBufNew(2);
     set_text_scale(0.75f);
 }
-screen::~screen()
-{
-    for(auto& el : row_elems)
-    {
-        C2D_TextBufDelete(el.buf);
-    }
-    C2D_TextBufDelete(size_tbuf);
-}
 
 std::size_t screen::columns() const
 {
@@ -38,10 +48,7 @@ std::size_t screen::rows() const
 void screen::set_text_scale(float scale)
 {
     text_scale = scale;
-    C2D_Text txt;
-    C2D_TextBufClear(size_tbuf);
-    C2D_TextFontParse(&txt, fnt, size_tbuf, "O");
-    C2D_TextGetDimensions(&txt, text_scale, text_scale, &charW, &charH);
+    backend.measure_glyph(glyphs.lookup('O'), text_scale, charW, charH);
     recalculate_sizes();
 }
 void screen::set_output_buffer_size(std::size_t width, std::size_t height)
@@ -52,522 +59,659 @@ void screen::set_output_buffer_size(std::size_t width, std::size_t height)
 }
 void screen::recalculate_sizes()
 {
-    current_cols = std::floor(output_width / charW);
-    current_rows = std::floor(output_height / charH);
-    fprintf(stderr, "set screen to %zdx%zd cells @ %.1fx%.1f char, %zdx%zd screen\n", current_cols, current_rows, charW, charH, output_width, output_height);
-    row_elems.resize(current_rows);
-    for(auto& el : row_elems)
+    // never less than one cell, the cursor math counts on a last row and a last column
+    const std::size_t new_cols = std::max<std::size_t>(std::floor(output_width / charW), 1);
+    const std::size_t new_rows = std::max<std::size_t>(std::floor(output_height / charH), 1);
+    fprintf(stderr, "set screen to %zdx%zd cells @ %.1fx%.1f char, %zdx%zd screen\n", new_cols, new_rows, charW, charH, output_width, output_height);
+    reflow(new_cols, new_rows);
+    // live rows use the slot of their physical row, history rows the ones after
+    backend.resize_row_cache(current_rows * 2, current_cols * charW, charH, CLEAR_COLOR);
+    view_offset = 0;
+    view_dirty = false;
+    size_history_view();
+}
+void screen::reflow(std::size_t new_cols, std::size_t new_rows)
+{
+    const auto OLD_ROWS = rows(), OLD_COLS = columns();
+    if(new_cols == OLD_COLS)
+    {
+        // nothing to rewrap, rows only come and go
+        if(new_rows != OLD_ROWS)
+            resize_rows(new_rows);
+        return;
+    }
+
+    struct cell_style {
+        u8 fg, bg, attrs;
+    };
+    struct line {
+        std::u32string text;
+        std::vector<cell_style> styles;
+    };
+
+    // the line the top row goes on from comes back out of the scrollback to be rewrapped with the rest of it,
+    // what stays in there is rewrapped in place
+    std::vector<line> lines(1);
+    std::u32string popped;
+    while(history.pop_wrapped(popped, run_scratch))
     {
-        C2D_TextBufDelete(el.buf);
-        el.buf = C2D_TextBufNew(current_cols);
-        el.chars.resize(current_cols);
-        el.value.clear();
-        el.updated = false;
-        for(auto& c : el.chars)
+        // runs cover the whole row, only the cells under its text are part of the line
+        std::vector<cell_style> styles;
+        for(const auto& run : run_scratch)
+            styles.insert(styles.end(), run.length, {run.fg, run.bg, run.attrs});
+        styles.resize(popped.size(), {DEFAULT_FG_IDX, DEFAULT_BG_IDX, 0});
+        lines[0].text.insert(0, popped);
+        lines[0].styles.insert(lines[0].styles.begin(), styles.begin(), styles.end());
+    }
+    history.rewrap(new_cols);
+
+    // join soft-wrapped rows back into the lines they came from
+    std::size_t cursor_line = 0, cursor_pos = 0;
+    for(std::size_t y = 0; y < OLD_ROWS; ++y)
+    {
+        const auto& el = row_at(y);
+        if(y != 0 && !row_at(y - 1).wrapped)
+            lines.emplace_back();
+        auto& l = lines.back();
+
+        if(y == cursor_y)
         {
-            c.have_fg = false;
-            c.fg = fg;
-            c.bg = bg;
+            cursor_line = lines.size() - 1;
+            cursor_pos = l.text.size() + cursor_x + scroll_x + (wrap_pending ? 1 : 0);
         }
+
+        const auto base = physical_row(y) * cells.width;
+        l.text += el.value;
+        for(std::size_t x = 0; x < el.value.size(); ++x)
+        {
+            const auto idx = base + std::min(x, OLD_COLS - 1);
+            l.styles.push_back({cells.fg[idx], cells.bg[idx], cells.attrs[idx]});
+        }
+    }
+    // nothing below the cursor's line is worth keeping if it's blank
+    while(lines.size() > cursor_line + 1 && lines.back().text.empty())
+        lines.pop_back();
+
+    current_cols = new_cols;
+    current_rows = new_rows;
+    row_elems.assign(new_rows, row{});
+    row_head = 0;
+    cells.resize(new_rows, new_cols);
+    cursor_x = cursor_y = scroll_x = 0;
+    wrap_pending = false;
+    if(!new_rows || !new_cols)
+        return;
+
+    // cut the lines again at the new width, remembering where the cursor lands
+    struct wrapped_row {
+        std::size_t line, from, to;
+        bool wrapped;
+    };
+    std::vector<wrapped_row> out_rows;
+    std::size_t cursor_row = 0, cursor_col = 0;
+    for(std::size_t i = 0; i < lines.size(); ++i)
+    {
+        const auto size = lines[i].text.size();
+        const std::size_t width = autowrap ? new_cols : std::max<std::size_t>(size, 1);
+        std::size_t from = 0;
+        do {
+            const std::size_t to = std::min(from + width, size);
+            if(i == cursor_line && cursor_pos >= from && (cursor_pos < from + width || to == size))
+            {
+                cursor_row = out_rows.size();
+                cursor_col = cursor_pos - from;
+            }
+            out_rows.push_back({i, from, to, to != size});
+            from = to;
+        } while(from < size);
     }
+
+    // keep the bottom of the content on screen, unless that would hide the cursor
+    std::size_t first = out_rows.size() > new_rows ? out_rows.size() - new_rows : 0;
+    first = std::min(first, cursor_row);
+    const auto fill_row = [&](std::size_t y, const wrapped_row& r) {
+        const auto& l = lines[r.line];
+        auto& el = row_at(y);
+        el.value.assign(l.text, r.from, r.to - r.from);
+        el.wrapped = r.wrapped;
+        el.updated = true;
+        const auto base = physical_row(y) * cells.width;
+        for(std::size_t x = r.from; x < r.to && x - r.from < new_cols; ++x)
+        {
+            const auto& st = l.styles[x];
+            cells.fg[base + x - r.from] = st.fg;
+            cells.bg[base + x - r.from] = st.bg;
+            cells.attrs[base + x - r.from] = st.attrs;
+        }
+    };
+    for(std::size_t i = 0; i < first; ++i)
+    {
+        // rows that don't fit anymore go through the top row into the scrollback
+        fill_row(0, out_rows[i]);
+        push_history(0);
+    }
+    for(std::size_t i = first; i < out_rows.size() && i - first < new_rows; ++i)
+    {
+        fill_row(i - first, out_rows[i]);
+    }
+
+    cursor_y = cursor_row - first;
+    if(cursor_col < new_cols)
+    {
+        cursor_x = cursor_col;
+    }
+    else if(autowrap)
+    {
+        cursor_x = new_cols - 1;
+        wrap_pending = true;
+    }
+    else
+    {
+        cursor_x = new_cols - 1;
+        scroll_x = cursor_col - cursor_x;
+    }
+}
+void screen::resize_rows(std::size_t new_rows)
+{
+    // blank rows below the cursor go first, then rows off the top into the scrollback, as long as the cursor stays
+    std::size_t keep = rows();
+    while(keep > cursor_y + 1 && row_at(keep - 1).value.empty() && !row_at(keep - 2).wrapped)
+        --keep;
+    const std::size_t first = std::min(keep > new_rows ? keep - new_rows : 0, cursor_y);
+    for(std::size_t y = 0; y < first; ++y)
+        push_history(y);
+
+    // the rows that stay keep their text and their laid out cells
+    const auto COLS = columns();
+    std::vector<row> new_elems(new_rows);
+    cell_grid new_cells;
+    new_cells.resize(new_rows, COLS);
+    for(std::size_t y = first; y < keep && y - first < new_rows; ++y)
+    {
+        auto& el = new_elems[y - first];
+        el = std::move(row_at(y));
+        el.cached = false;
+        const auto from = physical_row(y) * COLS, to = (y - first) * COLS;
+        std::copy_n(cells.glyph.begin() + from, COLS, new_cells.glyph.begin() + to);
+        std::copy_n(cells.fg.begin() + from, COLS, new_cells.fg.begin() + to);
+        std::copy_n(cells.bg.begin() + from, COLS, new_cells.bg.begin() + to);
+        std::copy_n(cells.attrs.begin() + from, COLS, new_cells.attrs.begin() + to);
+    }
+    row_elems = std::move(new_elems);
+    cells = std::move(new_cells);
+    row_head = 0;
+    current_rows = new_rows;
+    cursor_y -= first;
+}
+void screen::set_scrollback_depth(std::size_t depth)
+{
+    history.set_depth(depth);
+    reset_view();
+}
+std::size_t screen::scrollback_size() const
+{
+    return history.size();
+}
+std::size_t screen::scrollback_memory() const
+{
+    return history.memory_usage();
+}
+std::size_t screen::memory_usage() const
+{
+    std::size_t total = sizeof(screen);
+    total += cells.memory_usage() + history_cells.memory_usage();
+    total += truecolors.capacity() * sizeof(u32) + truecolor_lookup.capacity() * sizeof(u16) + truecolor_free.capacity();
+    total += (row_elems.capacity() + history_rows.capacity()) * sizeof(row);
+    for(const auto& el : row_elems)
+    {
+        total += el.value.capacity() * sizeof(char32_t);
+    }
+    for(const auto& el : history_rows)
+    {
+        total += el.value.capacity() * sizeof(char32_t);
+    }
+    return total;
+}
+void screen::scroll_back(std::size_t lines)
+{
+    view_offset = std::min(view_offset + lines, history.size());
+    view_dirty = true;
+    size_history_view();
+}
+void screen::scroll_forward(std::size_t lines)
+{
+    view_offset -= std::min(lines, view_offset);
+    view_dirty = true;
+    size_history_view();
+}
+void screen::reset_view()
+{
+    if(view_offset)
+    {
+        view_offset = 0;
+        view_dirty = true;
+        size_history_view();
+    }
+}
+void screen::size_history_view()
+{
+    // a screen's worth of rows while paging through the scrollback, nothing the rest of the time
+    if(!view_offset)
+    {
+        history_rows = std::vector<row>();
+        history_cells = cell_grid();
+    }
+    else if(history_rows.size() != current_rows || history_cells.width != current_cols)
+    {
+        history_rows.assign(current_rows, row());
+        history_cells.resize(current_rows, current_cols);
+    }
+}
+const screen::counters& screen::stats() const
+{
+    return totals;
 }
 void screen::print(std::string_view str)
 {
-    while(!str.empty())
-    {
-        if(str[0] == '\e' && str.size() > 1 && str[1] == '[')
-        {
-            str.remove_prefix(2);
-            bool escaping = true;
-            std::string_view escapeseq = str;
-            do {
-                const char chr = str.front();
-                str.remove_prefix(1);
-                if((chr >= '0' && chr <= '9') || chr == ';')
-                    continue;
-                
-                switch(chr)
-                {
-                case 'A':
-                    {
-                    const unsigned parameter = escapeseq.front() == 'A' ? 1 : readStr<unsigned>(escapeseq);
-                    cursor_y  =  (cursor_y  - parameter) < 0 ? 0 : (cursor_y  - parameter);
-                    scroll_x = 0;
-                    escaping = false;
-                    }
-                    break;
-                case 'B':
-                    {
-                    const auto COLS = columns();
-                    const unsigned parameter = escapeseq.front() == 'B' ? 1 : readStr<unsigned>(escapeseq);
-                    cursor_y  =  (cursor_y + parameter) > (COLS - 1) ? (COLS - 1) : (cursor_y  + parameter);
-                    scroll_x = 0;
-                    escaping = false;
-                    }
-                    break;
-                case 'C':
-                    {
-                    const auto COLS = columns();
-                    const unsigned parameter = escapeseq.front() == 'C' ? 1 : readStr<unsigned>(escapeseq);
-                    if((cursor_x + parameter) > (COLS - 1))
-                    {
-                        const auto old_x = cursor_x;
-                        cursor_x = (COLS - 1);
-                        scroll_x -= parameter - (cursor_x - old_x);
-                        row_elems[cursor_y].updated = true;
-                    }
-                    else
-                    {
-                        cursor_x += parameter;
-                    }
-                    escaping = false;
-                    }
-                    break;
-                case 'D':
-                    {
-                    const unsigned parameter = escapeseq.front() == 'D' ? 1 : readStr<unsigned>(escapeseq);
-                    if(cursor_x < parameter)
-                    {
-                        const auto old_x = cursor_x;
-                        cursor_x = 0;
-                        if(scroll_x < (parameter - old_x))
-                        {
-                            scroll_x = 0;
-                        }
-                        else
-                        {
-                            scroll_x -= parameter - old_x;
-                        }
-                        row_elems[cursor_y].updated = true;
-                    }
-                    else
-                    {
-                        cursor_x -= parameter;
-                    }
-                    escaping = false;
-                    }
-                    break;
-                case 'S': // scroll up
-                    {
-                    const unsigned parameter = escapeseq.front() == 'S' ? 1 : readStr<unsigned>(escapeseq);
-                    if(parameter < row_elems.size() && parameter)
-                    {
-                        std::rotate(row_elems.begin(), row_elems.begin() + parameter, row_elems.end());
-                    }
-                    unsigned i = 0;
-                    for(auto it = row_elems.rbegin(), fin = row_elems.rend(); i < parameter && it != fin; ++i, ++it)
-                    {
-                        auto& e = *it;
-                        e.value.clear();
-                        e.updated = true;
-                    }
-                    escaping = false;
-                    }
-                    break;
-                case 'T': // scroll down
-                    {
-                    const unsigned parameter = escapeseq.front() == 'T' ? 1 : readStr<unsigned>(escapeseq);
-                    if(parameter < row_elems.size() && parameter)
-                    {
-                        std::rotate(row_elems.rbegin(), row_elems.rbegin() + parameter, row_elems.rend());
-                    }
-                    unsigned i = 0;
-                    for(auto it = row_elems.begin(), fin = row_elems.end(); i < parameter && it != fin; ++i, ++it)
-                    {
-                        auto& e = *it;
-                        e.value.clear();
-                        e.updated = true;
-                    }
-                    escaping = false;
-                    }
-                    break;
-                case 'H':
-                case 'f':
-                {
-                    unsigned x, y;
-                    if(escapeseq.front() == ';' ) // no y provided
-                    {
-                        y = 1;
-                        escapeseq.remove_prefix(1);
-                    }
-                    else
-                    {
-                        y = readStr<unsigned>(escapeseq);
-                        escapeseq.remove_prefix(1); // remove ';'
-                    }
-
-                    if(escapeseq.front() == chr) // no x provided
-                    {
-                        x = 1;
-                    }
-                    else
-                    {
-                        x = readStr<unsigned>(escapeseq);
-                    }
-
-                    if(y == 0)
-                        y = 1;
-                    if(x == 0)
-                        x = 1;
-
-                    cursor_y = y - 1;
-                    cursor_x = x - 1;
-                    scroll_x = 0;
-
-                    escaping = false;
-                    break;
-                }
-                //---------------------------------------
-                // Screen clear
-                //---------------------------------------
-                case 'J':
-                    switch(escapeseq.front())
-                    {
-                    case 'J':
-                    case '0':
-                        // cursor -> EOS
-                        {
-                            for(std::size_t y = cursor_y, ROWS = rows(); y < ROWS; ++y)
-                            {
-                                row_elems[y].updated = true;
-                                if(y == cursor_y)
-                                {
-                                    row_elems[y].value.erase(cursor_x + scroll_x);
-                                    std::size_t x = 0;
-                                    for(auto& c : row_elems[y].chars)
-                                    {
-                                        if(x++ >= cursor_x)
-                                        {
-                                            c.have_fg = false;
-                                            c.bg = bg;
-                                            c.fg = fg;
-                                        }
-                                    }
-                                }
-                                else
-                                {
-                                    row_elems[y].value.clear();
-                                    for(auto& c : row_elems[y].chars)
-                                    {
-                                        c.have_fg = false;
-                                        c.bg = bg;
-                                        c.fg = fg;
-                                    }
-                                }
-                            }
-                        }
-                        break;
-                    case '1':
-                        // BOS -> cursor
-                        for(std::size_t y = 0; y <= cursor_y; ++y)
-                        {
-                            row_elems[y].updated = true;
-                            if(y == cursor_y)
-                            {
-                                if(cursor_x + scroll_x)
-                                {
-                                    row_elems[y].value.erase(0, cursor_x + scroll_x);
-                                    std::size_t x = 0;
-                                    for(auto& c : row_elems[y].chars)
-                                    {
-                                        if(x++ < cursor_x)
-                                        {
-                                            c.have_fg = false;
-                                            c.bg = bg;
-                                            c.fg = fg;
-                                        }
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                for(auto& c : row_elems[y].chars)
-                                {
-                                    c.have_fg = false;
-                                    c.bg = bg;
-                                    c.fg = fg;
-                                }
-                                row_elems[y].value.clear();
-                            }
-                        }
-                        break;
-                    case '2':
-                        // whole screen
-                        for(std::size_t y = 0, ROWS = rows(); y < ROWS; ++y)
-                        {
-                            row_elems[y].value.clear();
-                            row_elems[y].updated = true;
-                            for(auto& c : row_elems[y].chars)
-                            {
-                                c.have_fg = false;
-                                c.bg = bg;
-                                c.fg = fg;
-                            }
-                        }
-                        cursor_x = 0;
-                        cursor_y = 0;
-                        break;
-                    }
-                    escaping = false;
-                    break;
-                //---------------------------------------
-                // Line clear
-                //---------------------------------------
-                case 'K':
-                    switch(escapeseq.front())
-                    {
-                    case 'K':
-                    case '0':
-                        // cursor -> EOL
-                        {
-                        row_elems[cursor_y].value.erase(cursor_x + scroll_x);
-                        row_elems[cursor_y].updated = true;
-                        std::size_t x = 0;
-                        for(auto& c : row_elems[cursor_y].chars)
-                        {
-                            if(x++ >= cursor_x)
-                            {
-                                c.have_fg = false;
-                                c.bg = bg;
-                                c.fg = fg;
-                            }
-                        }
-                        }
-                        break;
-                    case '1':
-                        // BOL -> cursor
-                        {
-                        row_elems[cursor_y].value.erase(0, cursor_x + scroll_x);
-                        row_elems[cursor_y].updated = true;
-                        scroll_x = 0;
-                        std::size_t x = 0;
-                        for(auto& c : row_elems[cursor_y].chars)
-                        {
-                            if(x++ < cursor_x)
-                            {
-                                c.have_fg = false;
-                                c.bg = bg;
-                                c.fg = fg;
-                            }
-                        }
-                        }
-                        break;
-                    case '2':
-                        // whole line
-                        row_elems[cursor_y].value.clear();
-                        row_elems[cursor_y].updated = true;
-                        scroll_x = 0;
-                        for(auto& c : row_elems[cursor_y].chars)
-                        {
-                            c.have_fg = false;
-                            c.bg = bg;
-                            c.fg = fg;
-                        }
-                        break;
-                    }
-                    escaping = false;
-                    break;
-                case 'm':
-                    do {
-                        unsigned code = 0;
-                        if(escapeseq.front() != 'm')
-                        {
-                            code = readStr<unsigned>(escapeseq);
-                            if(escapeseq.front() == ';')
-                                escapeseq.remove_prefix(1);
-                        }
-
-                        switch(code)
-                        {
-                        case 0: // reset
-                            flags = DEFAULT_FLAGS;
-                            bg    = FIXED_COLOR_TABLE[DEFAULT_BG_IDX];
-                            fg    = FIXED_COLOR_TABLE[DEFAULT_FG_IDX];
-                            break;
-                        case 1: // bold
-                            flags &= ~CONSOLE_COLOR_FAINT;
-                            flags |= CONSOLE_COLOR_BOLD;
-                            break;
-
-                        case 2: // faint
-                            flags &= ~CONSOLE_COLOR_BOLD;
-                            flags |= CONSOLE_COLOR_FAINT;
-                            break;
-
-                        case 3: // italic
-                            flags |= CONSOLE_ITALIC;
-                            break;
-
-                        case 4: // underline
-                            flags |= CONSOLE_UNDERLINE;
-                            break;
-
-                        case 5: // blink slow
-                            flags &= ~CONSOLE_BLINK_FAST;
-                            flags |= CONSOLE_BLINK_SLOW;
-                            break;
-
-                        case 6: // blink fast
-                            flags &= ~CONSOLE_BLINK_SLOW;
-                            flags |= CONSOLE_BLINK_FAST;
-                            break;
-
-                        case 7: // reverse video
-                            flags |= CONSOLE_COLOR_REVERSE;
-                            break;
-
-                        case 8: // conceal
-                            flags |= CONSOLE_CONCEAL;
-                            break;
-
-                        case 9: // crossed-out
-                            flags |= CONSOLE_CROSSED_OUT;
-                            break;
-
-                        case 21: // bold off
-                            flags &= ~CONSOLE_COLOR_BOLD;
-                            break;
-
-                        case 22: // normal color
-                            flags &= ~CONSOLE_COLOR_BOLD;
-                            flags &= ~CONSOLE_COLOR_FAINT;
-                            break;
-
-                        case 23: // italic off
-                            flags &= ~CONSOLE_ITALIC;
-                            break;
-
-                        case 24: // underline off
-                            flags &= ~CONSOLE_UNDERLINE;
-                            break;
-
-                        case 25: // blink off
-                            flags &= ~CONSOLE_BLINK_SLOW;
-                            flags &= ~CONSOLE_BLINK_FAST;
-                            break;
-
-                        case 27: // reverse off
-                            flags &= ~CONSOLE_COLOR_REVERSE;
-                            break;
-
-                        case 29: // crossed-out off
-                            flags &= ~CONSOLE_CROSSED_OUT;
-                            break;
-
-                        case 30 ... 37: // writing color
-                            fg     = FIXED_COLOR_TABLE[code - 30];
-                            break;
-                        case 90 ... 97: // bright writing color
-                            fg     = FIXED_COLOR_TABLE[code - 90 + 8];
-                            break;
-                        
-                        case 38: // special writing color
-                            if(escapeseq.front() == '2')
-                            {
-                                escapeseq.remove_prefix(2);
-                                u8 r = 0, g = 0, b = 0;
-
-                                if(escapeseq.front() != ';')
-                                {
-                                    r = readStr<unsigned>(escapeseq);
-                                }
-                                escapeseq.remove_prefix(1);
-                                
-                                if(escapeseq.front() != ';')
-                                {
-                                    g = readStr<unsigned>(escapeseq);
-                                }
-                                escapeseq.remove_prefix(1);
-
-                                if(escapeseq.front() != ';')
-                                {
-                                    b = readStr<unsigned>(escapeseq);
-                                }
-                                if(escapeseq.front() == ';')
-                                    escapeseq.remove_prefix(1);
-
-                                fg = C2D_Color32(r,g,b,255);
-                            }
-                            else if(escapeseq.front() == '5')
-                            {
-                                escapeseq.remove_prefix(2);
-                                const unsigned n = readStr<unsigned>(escapeseq);
-                                fg = FIXED_COLOR_TABLE[n & 0xff];
-                            }
-                            else
-                            {
-                                // ???
-                            }
-                            break;
-
-                        case 39: // reset foreground color
-                            fg     = FIXED_COLOR_TABLE[DEFAULT_FG_IDX];
-                            break;
-
-                        case 40 ... 47: // screen color
-                            bg = FIXED_COLOR_TABLE[code - 40];
-                            break;
-                        case 100 ... 107: // bright screen color
-                            bg = FIXED_COLOR_TABLE[code - 100 + 8];
-                            break;
-
-                        case 48: // special screen color
-                            if(escapeseq.front() == '2')
-                            {
-                                escapeseq.remove_prefix(2);
-                                u8 r = 0, g = 0, b = 0;
-
-                                if(escapeseq.front() != ';')
-                                {
-                                    r = readStr<unsigned>(escapeseq);
-                                }
-                                escapeseq.remove_prefix(1);
-                                
-                                if(escapeseq.front() != ';')
-                                {
-                                    g = readStr<unsigned>(escapeseq);
-                                }
-                                escapeseq.remove_prefix(1);
-
-                                if(escapeseq.front() != ';')
-                                {
-                                    b = readStr<unsigned>(escapeseq);
-                                }
-                                if(escapeseq.front() == ';')
-                                    escapeseq.remove_prefix(1);
-
-                                bg = C2D_Color32(r,g,b,255);
-                            }
-                            else if(escapeseq.front() == '5')
-                            {
-                                escapeseq.remove_prefix(2);
-                                const unsigned n = readStr<unsigned>(escapeseq);
-                                bg = FIXED_COLOR_TABLE[n & 0xff];
-                            }
-                            else
-                            {
-                                // ???
-                            }
-                            break;
-
-                        case 49: // reset background color
-                            bg = FIXED_COLOR_TABLE[DEFAULT_BG_IDX];
-                            break;
-                        }
-                    } while(escapeseq.front() != 'm');
-                    escaping = false;
-                    break;
-                default:
-                    // some sort of unsupported escape; just gloss over it
-                    escaping = false;
-                    break;
-                }
-            } while (escaping);
+    totals.bytes_printed += str.size();
+    parser.feed(str, *this);
+}
+void screen::on_print(std::string_view run)
+{
+    decoded.clear();
+    decoder.decode(run, decoded);
+    print_codepoints(decoded);
+}
+void screen::interrupt_decoder()
+{
+    if(decoder.pending())
+    {
+        decoded.clear();
+        decoder.interrupt(decoded);
+        print_codepoints(decoded);
+    }
+}
+void screen::print_codepoints(std::u32string_view run)
+{
+    while(!run.empty())
+    {
+        if(autowrap && wrap_pending)
+            soft_wrap();
+
+        // whatever fits on the row goes in at once; without autowrap the last column takes the scrolling path
+        const auto COLS = columns();
+        const std::size_t room = autowrap ? COLS - cursor_x : (cursor_x + 1 < COLS ? COLS - 1 - cursor_x : 0);
+        const std::size_t fits = std::min(run.size(), room);
+        if(!fits)
+        {
+            printChar(run.front());
+            run.remove_prefix(1);
             continue;
         }
 
-        printChar(str.front());
-        str.remove_prefix(1);
+        auto& e = row_at(cursor_y);
+        auto& s = e.value;
+        const auto pos = cursor_x + scroll_x;
+        // pads with spaces if the cursor is past the end of the text
+        s.resize(std::max(s.size(), pos + fits), ' ');
+        std::copy_n(run.begin(), fits, s.begin() + pos);
+        e.updated = true;
+
+        const auto idx = physical_row(cursor_y) * cells.width + cursor_x;
+        std::fill_n(cells.fg.begin() + idx, fits, fg);
+        std::fill_n(cells.bg.begin() + idx, fits, bg);
+        std::fill_n(cells.attrs.begin() + idx, fits, current_attrs());
+
+        cursor_x += fits;
+        run.remove_prefix(fits);
+        if(cursor_x == COLS)
+        {
+            cursor_x -= 1;
+            wrap_pending = true;
+        }
+    }
+}
+void screen::soft_wrap()
+{
+    wrap_pending = false;
+    row_at(cursor_y).wrapped = true;
+    newLine();
+}
+void screen::on_execute(char c)
+{
+    interrupt_decoder();
+    wrap_pending = false;
+    switch(c)
+    {
+    case '\r':
+    case '\n':
+    case '\x08':
+        printChar(c);
+        break;
+    case '\t':
+        {
+        const auto TAB_WIDTH = 8;
+        const auto pos = cursor_x + scroll_x;
+        // tabs stop at the last column rather than wrapping, or scrolling the row sideways without autowrap
+        const auto last = scroll_x + columns() - 1;
+        const auto next = std::min<std::size_t>((pos / TAB_WIDTH + 1) * TAB_WIDTH, last);
+        for(std::size_t i = pos; i < next; ++i)
+        {
+            printChar(' ');
+        }
+        }
+        break;
+    default:
+        // BEL and the rest have no visible effect here
+        break;
+    }
+}
+void screen::on_esc(const vt_parser&, char)
+{
+    interrupt_decoder();
+    // no ESC sequence besides CSI is supported; ST and the like just end up here
+}
+void screen::on_csi(const vt_parser& seq, char final)
+{
+    interrupt_decoder();
+    if(seq.collected() == "?" && (final == 'h' || final == 'l'))
+    {
+        set_private_mode(seq, final == 'h');
+        return;
+    }
+    if(!seq.collected().empty())
+    {
+        // other private sequences and intermediates, unsupported
+        return;
+    }
+    if(final != 'm')
+    {
+        wrap_pending = false;
+    }
+
+    const auto ROWS = rows(), COLS = columns();
+    switch(final)
+    {
+    case 'A':
+        cursor_y -= std::min<std::size_t>(seq.param(0, 1), cursor_y);
+        scroll_x = 0;
+        break;
+    case 'B':
+        cursor_y = std::min<std::size_t>(cursor_y + seq.param(0, 1), ROWS - 1);
+        scroll_x = 0;
+        break;
+    case 'C':
+        {
+        const unsigned parameter = seq.param(0, 1);
+        if((cursor_x + parameter) > (COLS - 1))
+        {
+            const auto old_x = cursor_x;
+            cursor_x = (COLS - 1);
+            scroll_x += parameter - (cursor_x - old_x);
+            row_at(cursor_y).updated = true;
+        }
+        else
+        {
+            cursor_x += parameter;
+        }
+        }
+        break;
+    case 'D':
+        {
+        const unsigned parameter = seq.param(0, 1);
+        if(cursor_x < parameter)
+        {
+            const auto old_x = cursor_x;
+            cursor_x = 0;
+            scroll_x -= std::min<std::size_t>(parameter - old_x, scroll_x);
+            row_at(cursor_y).updated = true;
+        }
+        else
+        {
+            cursor_x -= parameter;
+        }
+        }
+        break;
+    case 'S': // scroll up
+        scroll_up(seq.param(0, 1));
+        break;
+    case 'T': // scroll down
+        scroll_down(seq.param(0, 1));
+        break;
+    case 'H':
+    case 'f':
+        // parameters read as at least 1 and the grid is at least 1x1, neither goes below 0
+        cursor_y = std::min<std::size_t>(seq.param(0, 1), ROWS) - 1;
+        cursor_x = std::min<std::size_t>(seq.param(1, 1), COLS) - 1;
+        scroll_x = 0;
+        break;
+    //---------------------------------------
+    // Screen clear
+    //---------------------------------------
+    case 'J':
+        switch(seq.param(0, 0))
+        {
+        case 0:
+            // cursor -> EOS
+            erase_row_text(cursor_y, cursor_x + scroll_x, std::u32string::npos);
+            clear_cells(cursor_y, cursor_x, COLS);
+            for(std::size_t y = cursor_y + 1; y < ROWS; ++y)
+            {
+                clear_row(y);
+            }
+            break;
+        case 1:
+            // BOS -> cursor
+            for(std::size_t y = 0; y < cursor_y; ++y)
+            {
+                clear_row(y);
+            }
+            if(cursor_x + scroll_x)
+            {
+                erase_row_text(cursor_y, 0, cursor_x + scroll_x);
+                clear_cells(cursor_y, 0, cursor_x);
+            }
+            break;
+        case 2:
+            // whole screen
+            for(std::size_t y = 0; y < ROWS; ++y)
+            {
+                clear_row(y);
+            }
+            cursor_x = 0;
+            cursor_y = 0;
+            break;
+        }
+        break;
+    //---------------------------------------
+    // Line clear
+    //---------------------------------------
+    case 'K':
+        switch(seq.param(0, 0))
+        {
+        case 0:
+            // cursor -> EOL
+            erase_row_text(cursor_y, cursor_x + scroll_x, std::u32string::npos);
+            clear_cells(cursor_y, cursor_x, COLS);
+            break;
+        case 1:
+            // BOL -> cursor
+            erase_row_text(cursor_y, 0, cursor_x + scroll_x);
+            clear_cells(cursor_y, 0, cursor_x);
+            scroll_x = 0;
+            break;
+        case 2:
+            // whole line
+            clear_row(cursor_y);
+            scroll_x = 0;
+            break;
+        }
+        break;
+    case 'm':
+        set_graphics_rendition(seq);
+        break;
+    default:
+        // some sort of unsupported escape; just gloss over it
+        break;
+    }
+}
+void screen::set_private_mode(const vt_parser& seq, bool enable)
+{
+    for(std::size_t i = 0, count = seq.param_total(); i < count; ++i)
+    {
+        switch(seq.param(i, 0))
+        {
+        case 7: // DECAWM
+            autowrap = enable;
+            wrap_pending = false;
+            break;
+        default:
+            break;
+        }
+    }
+}
+void screen::set_graphics_rendition(const vt_parser& seq)
+{
+    // a bare ESC[m is a reset, like ESC[0m
+    const std::size_t count = std::max<std::size_t>(seq.param_total(), 1);
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        const unsigned code = seq.param(i, 0);
+        switch(code)
+        {
+        case 0: // reset
+            flags = DEFAULT_FLAGS;
+            set_bg(DEFAULT_BG_IDX);
+            set_fg(DEFAULT_FG_IDX);
+            color_attrs = 0;
+            break;
+        case 1: // bold
+            flags &= ~CONSOLE_COLOR_FAINT;
+            flags |= CONSOLE_COLOR_BOLD;
+            break;
+
+        case 2: // faint
+            flags &= ~CONSOLE_COLOR_BOLD;
+            flags |= CONSOLE_COLOR_FAINT;
+            break;
+
+        case 3: // italic
+            flags |= CONSOLE_ITALIC;
+            break;
+
+        case 4: // underline
+            flags |= CONSOLE_UNDERLINE;
+            break;
+
+        case 5: // blink slow
+            flags &= ~CONSOLE_BLINK_FAST;
+            flags |= CONSOLE_BLINK_SLOW;
+            break;
+
+        case 6: // blink fast
+            flags &= ~CONSOLE_BLINK_SLOW;
+            flags |= CONSOLE_BLINK_FAST;
+            break;
+
+        case 7: // reverse video
+            flags |= CONSOLE_COLOR_REVERSE;
+            break;
+
+        case 8: // conceal
+            flags |= CONSOLE_CONCEAL;
+            break;
+
+        case 9: // crossed-out
+            flags |= CONSOLE_CROSSED_OUT;
+            break;
+
+        case 21: // bold off
+            flags &= ~CONSOLE_COLOR_BOLD;
+            break;
+
+        case 22: // normal color
+            flags &= ~CONSOLE_COLOR_BOLD;
+            flags &= ~CONSOLE_COLOR_FAINT;
+            break;
+
+        case 23: // italic off
+            flags &= ~CONSOLE_ITALIC;
+            break;
+
+        case 24: // underline off
+            flags &= ~CONSOLE_UNDERLINE;
+            break;
+
+        case 25: // blink off
+            flags &= ~CONSOLE_BLINK_SLOW;
+            flags &= ~CONSOLE_BLINK_FAST;
+            break;
+
+        case 27: // reverse off
+            flags &= ~CONSOLE_COLOR_REVERSE;
+            break;
+
+        case 28: // conceal off
+            flags &= ~CONSOLE_CONCEAL;
+            break;
+
+        case 29: // crossed-out off
+            flags &= ~CONSOLE_CROSSED_OUT;
+            break;
+
+        case 30 ... 37: // writing color
+            set_fg(code - 30);
+            break;
+        case 90 ... 97: // bright writing color
+            set_fg(code - 90 + 8);
+            break;
+
+        case 38: // special writing color
+        case 48: // special screen color
+            {
+            const bool is_fg = code == 38;
+            const unsigned kind = seq.param(i + 1, 0);
+            if(kind == 2)
+            {
+                const u32 color = color32(seq.param(i + 2, 0), seq.param(i + 3, 0), seq.param(i + 4, 0), 255);
+                if(is_fg)
+                    set_fg_truecolor(color);
+                else
+                    set_bg_truecolor(color);
+                i += 4;
+            }
+            else if(kind == 5)
+            {
+                const u8 n = seq.param(i + 2, 0) & 0xff;
+                if(is_fg)
+                    set_fg(n);
+                else
+                    set_bg(n);
+                i += 2;
+            }
+            else
+            {
+                // ???
+                i += 1;
+            }
+            }
+            break;
+
+        case 39: // reset foreground color
+            set_fg(DEFAULT_FG_IDX);
+            break;
+
+        case 40 ... 47: // screen color
+            set_bg(code - 40);
+            break;
+        case 100 ... 107: // bright screen color
+            set_bg(code - 100 + 8);
+            break;
+
+        case 49: // reset background color
+            set_bg(DEFAULT_BG_IDX);
+            break;
+        }
     }
 }
 void screen::tick()
@@ -595,35 +739,72 @@ void screen::tick()
         frame_counter = 0;
     }
 
-    u8 conversion_buf[17];
-
-    std::size_t idx = 0;
-    const auto COLS = columns();
-    for(auto& el : row_elems)
+    if(view_dirty)
     {
-        const auto i = idx++;
-        if(!el.updated) continue;
+        load_history_rows();
+    }
 
-        el.updated = false;
-        std::u32string_view sv(el.value);
-        if(i == cursor_y && scroll_x)
+    const auto ROWS = rows();
+    for(std::size_t i = 0; i < ROWS; ++i)
+    {
+        auto& el = row_at(i);
+        if(el.updated)
         {
-            sv.remove_prefix(scroll_x);
+            layout_row(el, cells, physical_row(i), i == cursor_y ? scroll_x : 0);
         }
-        std::size_t char_cnt = 0;
-        C2D_TextBufClear(el.buf);
-        for(const auto c : sv)
+    }
+    for(std::size_t i = 0, HIST = std::min(view_offset, ROWS); i < HIST; ++i)
+    {
+        auto& el = history_rows[i];
+        if(el.updated)
         {
-            conversion_buf[encode_utf8(conversion_buf, c)] = 0;
-            C2D_TextFontParse(&el.chars[char_cnt].text, fnt, el.buf, (const char*)conversion_buf);
-            el.chars[char_cnt].have_fg = true;
-            if(char_cnt++ == COLS)
-                break;
+            layout_row(el, history_cells, i, 0);
         }
-        for(; char_cnt < COLS; ++char_cnt)
+    }
+}
+void screen::layout_row(row& el, cell_grid& grid, std::size_t grid_row, std::size_t skip)
+{
+    el.updated = false;
+    el.cached = false;
+    totals.rows_laid_out += 1;
+    std::u32string_view sv(el.value);
+    sv.remove_prefix(std::min(skip, sv.size()));
+
+    const auto COLS = columns();
+    auto out = grid.glyph.begin() + grid_row * grid.width;
+    const auto out_end = out + COLS;
+    for(const auto c : sv)
+    {
+        if(out == out_end)
+            break;
+        *out++ = glyphs.lookup(c);
+    }
+    std::fill(out, out_end, glyph_cache::EMPTY);
+}
+void screen::load_history_rows()
+{
+    view_dirty = false;
+    const auto COLS = columns();
+    const auto HIST = std::min(view_offset, rows());
+    const auto first = history.size() - view_offset;
+    for(std::size_t i = 0; i < HIST; ++i)
+    {
+        auto& el = history_rows[i];
+        history.get(first + i, el.value, run_scratch);
+        std::size_t x = i * COLS;
+        const std::size_t row_end = x + COLS;
+        for(const auto& run : run_scratch)
         {
-            el.chars[char_cnt].have_fg = false;
+            const std::size_t run_end = std::min(x + run.length, row_end);
+            std::fill(history_cells.fg.begin() + x, history_cells.fg.begin() + run_end, run.fg);
+            std::fill(history_cells.bg.begin() + x, history_cells.bg.begin() + run_end, run.bg);
+            std::fill(history_cells.attrs.begin() + x, history_cells.attrs.begin() + run_end, run.attrs);
+            x = run_end;
         }
+        std::fill(history_cells.fg.begin() + x, history_cells.fg.begin() + row_end, DEFAULT_FG_IDX);
+        std::fill(history_cells.bg.begin() + x, history_cells.bg.begin() + row_end, DEFAULT_BG_IDX);
+        std::fill(history_cells.attrs.begin() + x, history_cells.attrs.begin() + row_end, 0);
+        el.updated = true;
     }
 }
 void screen::printChar(char32_t c)
@@ -641,8 +822,7 @@ void screen::printChar(char32_t c)
     {
         if((cursor_x + scroll_x) != 0)
         {
-            row_elems[cursor_y].value.erase(cursor_x + scroll_x - 1, 1);
-            row_elems[cursor_y].updated = true;
+            erase_row_text(cursor_y, cursor_x + scroll_x - 1, 1);
             if(cursor_x == 0)
                 scroll_x--;
             else
@@ -651,7 +831,10 @@ void screen::printChar(char32_t c)
     }
     else if(c != '\0')
     {
-        auto& e = row_elems[cursor_y];
+        if(autowrap && wrap_pending)
+            soft_wrap();
+
+        auto& e = row_at(cursor_y);
         auto& s = e.value;
         if((cursor_x + scroll_x) == s.size())
         {
@@ -663,17 +846,22 @@ void screen::printChar(char32_t c)
         }
         else // cursor + scroll longer than string, pad with space
         {
-            s.append(cursor_x + scroll_x - s.size(), ' ');
+            s.append(cursor_x + scroll_x - s.size() + 1, ' ');
             s.back() = c;
         }
         e.updated = true;
-        e.chars[cursor_x].bg = bg;
-        e.chars[cursor_x].fg = fg;
+        const auto idx = physical_row(cursor_y) * cells.width + cursor_x;
+        cells.fg[idx] = fg;
+        cells.bg[idx] = bg;
+        cells.attrs[idx] = current_attrs();
         cursor_x += 1;
         if(cursor_x == columns())
         {
             cursor_x -= 1;
-            scroll_x += 1;
+            if(autowrap)
+                wrap_pending = true;
+            else
+                scroll_x += 1;
         }
     }
 }
@@ -685,32 +873,311 @@ void screen::newLine()
     if(cursor_y == rows())
     {
         cursor_y -= 1;
-        std::rotate(row_elems.begin(), row_elems.begin() + 1, row_elems.end());
-        row_elems[cursor_y].value.clear();
-        row_elems[cursor_y].updated = true;
+        scroll_up(1);
+    }
+}
+void screen::scroll_up(std::size_t lines)
+{
+    const auto ROWS = rows();
+    lines = std::min(lines, ROWS);
+    for(std::size_t i = 0; i < lines; ++i)
+    {
+        push_history(0);
+        clear_row(0);
+        row_head = (row_head + 1) % ROWS;
+        totals.lines_scrolled += 1;
+    }
+}
+void screen::scroll_down(std::size_t lines)
+{
+    const auto ROWS = rows();
+    lines = std::min(lines, ROWS);
+    for(std::size_t i = 0; i < lines; ++i)
+    {
+        row_head = (row_head + ROWS - 1) % ROWS;
+        clear_row(0);
     }
 }
+void screen::clear_row(std::size_t y)
+{
+    row_at(y).value.clear();
+    row_at(y).wrapped = false;
+    clear_cells(y, 0, columns());
+}
+void screen::clear_cells(std::size_t y, std::size_t from, std::size_t to)
+{
+    row_at(y).updated = true;
+    const auto base = physical_row(y) * cells.width;
+    from = base + std::min(from, cells.width);
+    to = base + std::min(to, cells.width);
+    if(from >= to)
+        return;
 
+    std::fill(cells.glyph.begin() + from, cells.glyph.begin() + to, glyph_cache::EMPTY);
+    std::fill(cells.fg.begin() + from, cells.fg.begin() + to, fg);
+    std::fill(cells.bg.begin() + from, cells.bg.begin() + to, bg);
+    std::fill(cells.attrs.begin() + from, cells.attrs.begin() + to, current_attrs());
+}
+void screen::erase_row_text(std::size_t y, std::size_t pos, std::size_t count)
+{
+    auto& el = row_at(y);
+    if(pos < el.value.size())
+    {
+        el.value.erase(pos, count);
+    }
+    el.updated = true;
+}
+void screen::push_history(std::size_t y)
+{
+    run_scratch.clear();
+    const auto base = physical_row(y) * cells.width;
+    for(std::size_t i = base, fin = base + columns(); i < fin; ++i)
+    {
+        const auto c_fg = cells.fg[i], c_bg = cells.bg[i], c_attrs = cells.attrs[i];
+        if(!run_scratch.empty() && run_scratch.back().fg == c_fg && run_scratch.back().bg == c_bg && run_scratch.back().attrs == c_attrs)
+            run_scratch.back().length += 1;
+        else
+            run_scratch.push_back({1, c_fg, c_bg, c_attrs});
+    }
+    history.push(row_at(y).value, run_scratch, row_at(y).wrapped);
+
+    // keep showing the same lines while the user is looking back
+    if(view_offset)
+    {
+        view_offset = std::min(view_offset + 1, history.size());
+        view_dirty = true;
+    }
+}
+std::size_t screen::physical_row(std::size_t y) const
+{
+    return (row_head + y) % row_elems.size();
+}
+screen::row& screen::row_at(std::size_t y)
+{
+    return row_elems[physical_row(y)];
+}
+
+void screen::set_fg(u8 idx)
+{
+    fg = idx;
+    color_attrs &= ~ATTR_FG_TRUECOLOR;
+}
+void screen::set_bg(u8 idx)
+{
+    bg = idx;
+    color_attrs &= ~ATTR_BG_TRUECOLOR;
+}
+void screen::set_fg_truecolor(u32 color)
+{
+    if(const auto idx = truecolor_index(color))
+    {
+        fg = *idx;
+        color_attrs |= ATTR_FG_TRUECOLOR;
+    }
+    else
+    {
+        set_fg(nearest_palette_index(color));
+    }
+}
+void screen::set_bg_truecolor(u32 color)
+{
+    if(const auto idx = truecolor_index(color))
+    {
+        bg = *idx;
+        color_attrs |= ATTR_BG_TRUECOLOR;
+    }
+    else
+    {
+        set_bg(nearest_palette_index(color));
+    }
+}
+std::size_t screen::truecolor_slot(u32 color) const
+{
+    constexpr std::size_t MASK = (1 << TRUECOLOR_LOOKUP_BITS) - 1;
+    std::size_t slot = (color * 0x9e3779b1u) >> (32 - TRUECOLOR_LOOKUP_BITS);
+    while(truecolor_lookup[slot] && truecolors[truecolor_lookup[slot] - 1] != color)
+        slot = (slot + 1) & MASK;
+    return slot;
+}
+std::optional<u8> screen::truecolor_index(u32 color)
+{
+    if(truecolor_lookup.empty())
+        truecolor_lookup.resize(1 << TRUECOLOR_LOOKUP_BITS);
+    if(const auto found = truecolor_lookup[truecolor_slot(color)])
+        return found - 1;
+
+    u8 idx;
+    if(truecolors.size() < MAX_TRUECOLORS)
+    {
+        idx = truecolors.size();
+        truecolors.push_back(color);
+    }
+    else
+    {
+        if(truecolor_free.empty())
+            reclaim_truecolors();
+        if(truecolor_free.empty())
+            return std::nullopt;
+        idx = truecolor_free.back();
+        truecolor_free.pop_back();
+        truecolors[idx] = color;
+    }
+    truecolor_lookup[truecolor_slot(color)] = idx + 1;
+    return idx;
+}
+void screen::reclaim_truecolors()
+{
+    // a table full of colors still in use would otherwise be scanned again for every SGR
+    if(totals.bytes_printed < truecolor_next_scan)
+        return;
+    truecolor_next_scan = totals.bytes_printed + TRUECOLOR_SCAN_INTERVAL;
+
+    std::array<bool, MAX_TRUECOLORS> used{};
+    const auto mark = [&](u8 fg_idx, u8 bg_idx, u8 a) {
+        if(a & ATTR_FG_TRUECOLOR)
+            used[fg_idx] = true;
+        if(a & ATTR_BG_TRUECOLOR)
+            used[bg_idx] = true;
+    };
+    for(const cell_grid* grid : {&cells, &history_cells})
+    {
+        for(std::size_t i = 0; i < grid->attrs.size(); ++i)
+            mark(grid->fg[i], grid->bg[i], grid->attrs[i]);
+    }
+    history.for_each_run([&](const scrollback::color_run& run) { mark(run.fg, run.bg, run.attrs); });
+    mark(fg, bg, color_attrs);
+
+    // only what's still used stays findable, the rest is handed out again
+    std::fill(truecolor_lookup.begin(), truecolor_lookup.end(), 0);
+    truecolor_free.clear();
+    for(std::size_t i = MAX_TRUECOLORS; i-- > 0;)
+    {
+        if(used[i])
+            truecolor_lookup[truecolor_slot(truecolors[i])] = i + 1;
+        else
+            truecolor_free.push_back(i);
+    }
+}
+u8 screen::nearest_palette_index(u32 color)
+{
+    const auto channel = [](u32 c, unsigned shift) { return int((c >> shift) & 0xff); };
+    u8 best = 0;
+    int best_dist = INT_MAX;
+    for(std::size_t i = 0; i < FIXED_COLOR_TABLE.size(); ++i)
+    {
+        const u32 p = FIXED_COLOR_TABLE[i];
+        const int dr = channel(p, 0) - channel(color, 0);
+        const int dg = channel(p, 8) - channel(color, 8);
+        const int db = channel(p, 16) - channel(color, 16);
+        const int dist = dr * dr + dg * dg + db * db;
+        if(dist < best_dist)
+        {
+            best_dist = dist;
+            best = i;
+        }
+    }
+    return best;
+}
+u8 screen::current_attrs() const
+{
+    u8 out = color_attrs;
+    if(flags & CONSOLE_COLOR_BOLD)
+        out |= ATTR_BOLD;
+    if(flags & CONSOLE_COLOR_FAINT)
+        out |= ATTR_FAINT;
+    if(flags & CONSOLE_UNDERLINE)
+        out |= ATTR_UNDERLINE;
+    if(flags & CONSOLE_COLOR_REVERSE)
+        out |= ATTR_REVERSE;
+    if(flags & CONSOLE_CONCEAL)
+        out |= ATTR_CONCEAL;
+    return out;
+}
+u32 screen::resolve_fg(const cell_grid& grid, std::size_t idx) const
+{
+    const u8 a = grid.attrs[idx];
+    if(a & ATTR_REVERSE)
+        return a & ATTR_BG_TRUECOLOR ? truecolors[grid.bg[idx]] : FIXED_COLOR_TABLE[grid.bg[idx]];
+    return a & ATTR_FG_TRUECOLOR ? truecolors[grid.fg[idx]] : FIXED_COLOR_TABLE[grid.fg[idx]];
+}
+u32 screen::resolve_bg(const cell_grid& grid, std::size_t idx) const
+{
+    const u8 a = grid.attrs[idx];
+    if(a & ATTR_REVERSE)
+        return a & ATTR_FG_TRUECOLOR ? truecolors[grid.fg[idx]] : FIXED_COLOR_TABLE[grid.fg[idx]];
+    return a & ATTR_BG_TRUECOLOR ? truecolors[grid.bg[idx]] : FIXED_COLOR_TABLE[grid.bg[idx]];
+}
+
+void screen::draw_cells(const cell_grid& grid, std::size_t base, float y)
+{
+    const auto COLS = columns();
+    // one rect per run of same-colored cells, nothing where the target clear already shows
+    std::size_t run_start = 0;
+    u32 run_bg = resolve_bg(grid, base);
+    for(std::size_t x_idx = 1; x_idx <= COLS; ++x_idx)
+    {
+        const bool row_end = x_idx == COLS;
+        const u32 cell_bg = row_end ? 0 : resolve_bg(grid, base + x_idx);
+        if(!row_end && cell_bg == run_bg)
+            continue;
+
+        if(run_bg != CLEAR_COLOR)
+        {
+            backend.draw_rect(run_start * charW, y, 0.0f, (x_idx - run_start) * charW, charH, run_bg);
+        }
+        run_start = x_idx;
+        run_bg = cell_bg;
+    }
+
+    float x = 0.0f;
+    for(std::size_t x_idx = 0; x_idx < COLS; ++x_idx, x += charW)
+    {
+        const auto idx = base + x_idx;
+        const u8 a = grid.attrs[idx];
+        if(grid.glyph[idx] != glyph_cache::EMPTY && !(a & ATTR_CONCEAL))
+        {
+            backend.draw_glyph(grid.glyph[idx], x, y, 0.25f, text_scale, resolve_fg(grid, idx));
+        }
+        if(a & ATTR_UNDERLINE)
+        {
+            backend.draw_rect(x, y + charH - 1.0f, 0.25f, charW, 1.0f, resolve_fg(grid, idx));
+        }
+    }
+}
 void screen::draw()
 {
     float y = 0.0f;
     const auto ROWS = rows(), COLS = columns();
+    if(!COLS)
+        return;
+
     for(std::size_t y_idx = 0; y_idx < ROWS; ++y_idx, y += charH)
     {
-        float x = 0.0f;
-        const auto& el = row_elems[y_idx];
-        for(std::size_t x_idx = 0; x_idx < COLS; ++x_idx, x += charW)
+        const bool from_history = y_idx < view_offset;
+        const cell_grid& grid = from_history ? history_cells : cells;
+        const std::size_t grid_row = from_history ? y_idx : physical_row(y_idx - view_offset);
+        const std::size_t slot = from_history ? ROWS + y_idx : grid_row;
+        auto& el = from_history ? history_rows[y_idx] : row_elems[grid_row];
+
+        if(!el.cached)
         {
-            const auto& c = el.chars[x_idx];
-            C2D_DrawRectSolid(x, y, 0.0f, charW, charH, c.bg);
-            if(c.have_fg)
+            if(!backend.begin_row(slot))
             {
-                C2D_DrawText(&c.text, C2D_WithColor, x, y, 0.25f, text_scale, text_scale, c.fg);
-            }
-            if(x_idx == cursor_x && y_idx == cursor_y && cursor_visible)
-            {
-                C2D_DrawRectSolid(x, y, 0.5f, 2.0f, charH, c.bg ^ 0xffffff);
+                draw_cells(grid, grid_row * grid.width, y);
+                continue;
             }
+            draw_cells(grid, grid_row * grid.width, 0.0f);
+            backend.end_row();
+            el.cached = true;
+            totals.rows_rendered += 1;
         }
+        backend.draw_row(slot, 0.0f, y, 0.0f);
+    }
+
+    const auto shown_cursor_y = cursor_y + view_offset;
+    if(cursor_visible && shown_cursor_y < ROWS && cursor_x < COLS)
+    {
+        const u32 cell_bg = resolve_bg(cells, physical_row(cursor_y) * cells.width + cursor_x);
+        backend.draw_rect(cursor_x * charW, shown_cursor_y * charH, 0.5f, 2.0f, charH, cell_bg ^ 0xffffff);
     }
 }
@@ -1,18 +1,21 @@
 #pragma once
 
 #include <string_view>
-#include <charconv>
+#include <optional>
 #include <string>
 #include <vector>
 #include <array>
 
-#include <3ds.h>
-#include <citro3d.h>
-#include <citro2d.h>
+#include "platform.h"
+#include "render_backend.h"
+#include "glyph_cache.h"
+#include "scrollback.h"
+#include "vt_parser.h"
+#include "utf8_decoder.h"
 
 static inline constexpr std::array<u32, 256> buildColorTable()
 {
-    #define RGB8_TO_U32(a,b,c) C2D_Color32(a,b,c,255)
+    #define RGB8_TO_U32(a,b,c) color32(a,b,c,255)
     std::array<u32, 256> colorTable;
     colorTable[0] = RGB8_TO_U32(0,0,0);
     colorTable[1] = RGB8_TO_U32(205,0,0);
@@ -46,60 +49,160 @@ static inline constexpr std::array<u32, 256> buildColorTable()
 struct screen {
     static constexpr inline std::size_t MAX_ROWS = 24;
     static constexpr inline std::size_t MAX_COLS = 50;
+    static constexpr inline std::size_t DEFAULT_SCROLLBACK_DEPTH = 10000;
 
     std::size_t columns() const;
     std::size_t rows() const;
     void set_output_buffer_size(std::size_t width, std::size_t height);
     void set_text_scale(float scale);
+    void set_scrollback_depth(std::size_t depth);
+    std::size_t scrollback_size() const;
+    std::size_t scrollback_memory() const;
+
+    // page through the lines that scrolled off, 0 lines back is the live screen
+    void scroll_back(std::size_t lines);
+    void scroll_forward(std::size_t lines);
+    void reset_view();
+
+    // everything the terminal grid holds, scrollback excluded
+    std::size_t memory_usage() const;
+
+    // running totals, for measuring how fast output goes through
+    struct counters {
+        u64 bytes_printed;
+        u64 rows_laid_out;
+        u64 lines_scrolled;
+        // rows drawn again into their cache slot
+        u64 rows_rendered;
+    };
+    const counters& stats() const;
 
     std::size_t cursor_x{0}, cursor_y{0}, scroll_x{0};
+    // DECAWM, ESC[?7h / ESC[?7l: wrap to the next row at the last column instead of scrolling the row sideways
+    bool autowrap{true};
     unsigned frame_counter{0};
     bool cursor_visible{true};
 
     //set up the palette for color printing
     static inline constexpr std::array<u32, 256> FIXED_COLOR_TABLE = buildColorTable();
+    // what the render target is cleared to before draw(), backgrounds of that color are skipped
+    static inline constexpr u32 CLEAR_COLOR = FIXED_COLOR_TABLE[0];
 
-    struct character {
-        C2D_Text text;
-        u32 bg, fg;
-        bool have_fg;
+    // cell attribute bits; the truecolor ones mean fg/bg index the truecolor table instead of the palette
+    enum cell_attr : u8 {
+        ATTR_FG_TRUECOLOR = 1 << 0,
+        ATTR_BG_TRUECOLOR = 1 << 1,
+        ATTR_BOLD = 1 << 2,
+        ATTR_FAINT = 1 << 3,
+        ATTR_UNDERLINE = 1 << 4,
+        ATTR_REVERSE = 1 << 5,
+        ATTR_CONCEAL = 1 << 6,
     };
+    // distinct 24bit colors in use at once before falling back to the nearest palette entry; once the table is full,
+    // entries no cell or scrollback line uses anymore are taken back, at most once every TRUECOLOR_SCAN_INTERVAL bytes
+    static constexpr inline std::size_t MAX_TRUECOLORS = 256;
+    static constexpr inline std::size_t TRUECOLOR_SCAN_INTERVAL = 4096;
+
     struct row {
         std::u32string value;
-        std::vector<character> chars;
-        C2D_TextBuf buf{nullptr};
         bool updated{false};
+        // autowrap cut this row, its line goes on in the next one
+        bool wrapped{false};
+        // the backend's cached image of the row is up to date
+        bool cached{false};
     };
+    // cells as parallel arrays, one entry per cell, row after row
+    struct cell_grid {
+        std::vector<glyph_cache::index> glyph;
+        std::vector<u8> fg, bg, attrs;
+        std::size_t width{0};
 
+        void resize(std::size_t rows_arg, std::size_t cols_arg);
+        std::size_t memory_usage() const;
+    };
+
+    // ring of the on-screen rows, row_at(0) is the top one
     std::vector<row> row_elems;
+    cell_grid cells;
 
-    screen(C2D_Font fnt_arg);
-    ~screen();
+    screen(render_backend& backend_arg, std::size_t scrollback_depth = DEFAULT_SCROLLBACK_DEPTH);
 
     void print(std::string_view str);
     void tick();
     void draw();
 
 private:
+    friend struct vt_parser;
+    void on_print(std::string_view run);
+    void interrupt_decoder();
+    void print_codepoints(std::u32string_view run);
+    void on_execute(char c);
+    void on_esc(const vt_parser& seq, char final);
+    void on_csi(const vt_parser& seq, char final);
+    void set_graphics_rendition(const vt_parser& seq);
+
     void recalculate_sizes();
+    void reflow(std::size_t new_cols, std::size_t new_rows);
+    void resize_rows(std::size_t new_rows);
+    void set_private_mode(const vt_parser& seq, bool enable);
+    void soft_wrap();
     void printChar(char32_t c);
     void newLine();
-    template<typename T>
-    T readStr(std::string_view& from)
-    {
-        T out = 0;
-        auto res = std::from_chars(from.begin(), from.end(), out, 10);
-        const int diff = res.ptr - from.begin();
-        if(diff)
-            from.remove_prefix(diff);
-        return out;
-    }
-    C2D_Font fnt;
-    C2D_TextBuf size_tbuf;
+    void scroll_up(std::size_t lines);
+    void scroll_down(std::size_t lines);
+    void clear_row(std::size_t y);
+    void clear_cells(std::size_t y, std::size_t from, std::size_t to);
+    void erase_row_text(std::size_t y, std::size_t pos, std::size_t count);
+    void push_history(std::size_t y);
+    void layout_row(row& el, cell_grid& grid, std::size_t grid_row, std::size_t skip);
+    void draw_cells(const cell_grid& grid, std::size_t base, float y);
+    void load_history_rows();
+    void size_history_view();
+    std::size_t physical_row(std::size_t y) const;
+    row& row_at(std::size_t y);
+
+    void set_fg(u8 idx);
+    void set_bg(u8 idx);
+    void set_fg_truecolor(u32 color);
+    void set_bg_truecolor(u32 color);
+    std::optional<u8> truecolor_index(u32 color);
+    std::size_t truecolor_slot(u32 color) const;
+    void reclaim_truecolors();
+    static u8 nearest_palette_index(u32 color);
+    u8 current_attrs() const;
+    u32 resolve_fg(const cell_grid& grid, std::size_t idx) const;
+    u32 resolve_bg(const cell_grid& grid, std::size_t idx) const;
+
+    render_backend& backend;
+    counters totals{};
+    vt_parser parser;
+    utf8_decoder decoder;
+    std::u32string decoded;
+    scrollback history;
+    // the scrollback rows on screen, only allocated while view_offset isn't 0
+    std::vector<row> history_rows;
+    cell_grid history_cells;
+    std::vector<u32> truecolors;
+    // open addressing over truecolors, each slot holds an index + 1 or 0; twice the table so a probe ends quickly,
+    // allocated with the first 24bit color
+    static constexpr inline std::size_t TRUECOLOR_LOOKUP_BITS = 9;
+    std::vector<u16> truecolor_lookup;
+    // entries reclaim_truecolors found unused, and when it may look again
+    std::vector<u8> truecolor_free;
+    u64 truecolor_next_scan{0};
+    std::vector<scrollback::color_run> run_scratch;
+    std::size_t row_head{0};
+    std::size_t view_offset{0};
+    bool view_dirty{false};
+    glyph_cache glyphs;
     float text_scale;
-    std::size_t current_cols, current_rows;
+    std::size_t current_cols{0}, current_rows{0};
     std::size_t output_width, output_height;
     float charW, charH;
-    u32 bg, fg;
+    // palette index, or truecolor table index when color_attrs says so
+    u8 bg, fg;
+    u8 color_attrs{0};
+    // the last column was just written in autowrap mode, the next printable character goes on a new row
+    bool wrap_pending{false};
     unsigned flags;
 };
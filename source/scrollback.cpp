@@ -0,0 +1,198 @@
+#include "scrollback.h"
+#include "utf8_decoder.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+scrollback::scrollback(std::size_t depth_arg)
+{
+    set_depth(depth_arg);
+}
+
+void scrollback::set_depth(std::size_t depth_arg)
+{
+    max_depth = depth_arg;
+    clear();
+    lines.shrink_to_fit();
+}
+std::size_t scrollback::depth() const
+{
+    return max_depth;
+}
+std::size_t scrollback::size() const
+{
+    return count;
+}
+void scrollback::clear()
+{
+    lines.clear();
+    head = 0;
+    count = 0;
+}
+
+scrollback::line& scrollback::next_line()
+{
+    // the ring fills up lazily, then wraps and reuses the oldest entry's storage
+    if(head == lines.size())
+        lines.emplace_back();
+    auto& l = lines[head];
+    head = (head + 1) % max_depth;
+    count = std::min(count + 1, max_depth);
+    return l;
+}
+
+void scrollback::push(std::u32string_view text, std::span<const color_run> runs, bool wrapped)
+{
+    if(max_depth == 0)
+        return;
+
+    auto& l = next_line();
+    text = text.substr(0, MAX_LINE_CHARS);
+    runs = runs.first(std::min(runs.size(), MAX_LINE_RUNS));
+
+    l.data.clear();
+    char conversion_buf[4];
+    for(const auto c : text)
+    {
+        l.data.append(conversion_buf, utf8_decoder::encode(c, conversion_buf));
+    }
+    l.text_bytes = l.data.size();
+    l.run_count = runs.size();
+    l.wrapped = wrapped;
+    l.data.append((const char*)runs.data(), runs.size_bytes());
+}
+
+// text is already UTF-8 and no longer than MAX_LINE_CHARS
+void scrollback::push_packed(std::string_view text, std::span<const color_run> runs, bool wrapped)
+{
+    auto& l = next_line();
+    runs = runs.first(std::min(runs.size(), MAX_LINE_RUNS));
+    l.data.assign(text);
+    l.text_bytes = l.data.size();
+    l.run_count = runs.size();
+    l.wrapped = wrapped;
+    l.data.append((const char*)runs.data(), runs.size_bytes());
+}
+
+bool scrollback::get(std::size_t idx, std::u32string& text, std::vector<color_run>& runs) const
+{
+    text.clear();
+    runs.clear();
+    if(idx >= count)
+        return false;
+
+    const auto& l = lines[(head + max_depth - count + idx) % max_depth];
+    utf8_decoder decoder;
+    decoder.decode(std::string_view(l.data).substr(0, l.text_bytes), text);
+
+    runs.resize(l.run_count);
+    std::memcpy(runs.data(), l.data.data() + l.text_bytes, l.run_count * sizeof(color_run));
+    return l.wrapped;
+}
+
+bool scrollback::pop_wrapped(std::u32string& text, std::vector<color_run>& runs)
+{
+    if(!count)
+        return false;
+    const auto newest = (head + max_depth - 1) % max_depth;
+    if(!lines[newest].wrapped)
+        return false;
+
+    get(count - 1, text, runs);
+    lines[newest].data.clear();
+    lines[newest].run_count = 0;
+    head = newest;
+    count -= 1;
+    return true;
+}
+
+// codepoints in UTF-8 text, and the byte offset n codepoints in
+static std::size_t utf8_length(std::string_view text)
+{
+    return std::count_if(text.begin(), text.end(), [](char c) { return (c & 0xc0) != 0x80; });
+}
+static std::size_t utf8_advance(std::string_view text, std::size_t n)
+{
+    std::size_t at = 0;
+    for(; at < text.size(); ++at)
+    {
+        if((text[at] & 0xc0) != 0x80 && n-- == 0)
+            break;
+    }
+    return at;
+}
+
+void scrollback::rewrap(std::size_t width)
+{
+    width = std::min(width, MAX_LINE_CHARS);
+    if(!count || !width)
+        return;
+
+    // the lines are cut again as they're packed, no decoding; the ring is filled anew and each old line's
+    // storage is let go once it's been read, so there aren't two copies of the whole scrollback at once
+    std::vector<line> old;
+    old.swap(lines);
+    const std::size_t old_count = count, oldest = (head + max_depth - count) % max_depth;
+    head = 0;
+    count = 0;
+
+    std::string text;
+    std::vector<color_run> runs, piece_runs;
+    for(std::size_t i = 0; i < old_count; ++i)
+    {
+        auto& l = old[(oldest + i) % max_depth];
+        const std::string_view row_text(l.data.data(), l.text_bytes);
+        text += row_text;
+        // a cut row's runs past its text are cells its line never reached, only the last row's are kept
+        std::size_t cells = l.wrapped ? utf8_length(row_text) : SIZE_MAX;
+        for(std::size_t r = 0; r < l.run_count && cells; ++r)
+        {
+            color_run run;
+            std::memcpy(&run, l.data.data() + l.text_bytes + r * sizeof(color_run), sizeof(color_run));
+            run.length = std::min<std::size_t>(run.length, cells);
+            cells -= run.length;
+            runs.push_back(run);
+        }
+        const bool wrapped = l.wrapped;
+        std::string().swap(l.data);
+        if(wrapped && i + 1 < old_count)
+            continue;
+
+        std::size_t from = 0, run_idx = 0, run_used = 0;
+        do {
+            const std::size_t to = from + utf8_advance(std::string_view(text).substr(from), width);
+            // every piece gets width cells worth of runs, the last one what's left of them
+            piece_runs.clear();
+            for(std::size_t left = width; left && run_idx < runs.size();)
+            {
+                const auto& run = runs[run_idx];
+                const std::size_t take = std::min<std::size_t>(left, run.length - run_used);
+                if(!piece_runs.empty() && piece_runs.back().fg == run.fg && piece_runs.back().bg == run.bg && piece_runs.back().attrs == run.attrs)
+                    piece_runs.back().length += take;
+                else
+                    piece_runs.push_back({u16(take), run.fg, run.bg, run.attrs});
+                left -= take;
+                run_used += take;
+                if(run_used == run.length)
+                {
+                    ++run_idx;
+                    run_used = 0;
+                }
+            }
+            push_packed(std::string_view(text).substr(from, to - from), piece_runs, to != text.size() || wrapped);
+            from = to;
+        } while(from < text.size());
+        text.clear();
+        runs.clear();
+    }
+}
+
+std::size_t scrollback::memory_usage() const
+{
+    std::size_t total = lines.capacity() * sizeof(line);
+    for(const auto& l : lines)
+    {
+        total += l.data.capacity();
+    }
+    return total;
+}
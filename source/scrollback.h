@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string_view>
+#include <string>
+#include <vector>
+#include <span>
+#include <cstring>
+
+#include "platform.h"
+
+// lines that scrolled off the top of the screen, oldest first
+// kept in a fixed-depth ring, each line packed as UTF-8 followed by its color runs
+struct scrollback {
+    // longest line kept, in codepoints and in color runs; anything past it is cut
+    static constexpr inline std::size_t MAX_LINE_CHARS = 256;
+    static constexpr inline std::size_t MAX_LINE_RUNS = 64;
+
+    // same fields as a screen::cell_grid cell
+    struct color_run {
+        u16 length;
+        u8 fg, bg, attrs;
+    };
+
+    scrollback(std::size_t depth_arg);
+
+    void set_depth(std::size_t depth_arg);
+    std::size_t depth() const;
+    std::size_t size() const;
+    void clear();
+
+    // wrapped: the line goes on in the next one, it was only cut by autowrap
+    void push(std::u32string_view text, std::span<const color_run> runs, bool wrapped);
+    // idx 0 is the oldest line still kept, returns whether it was wrapped
+    bool get(std::size_t idx, std::u32string& text, std::vector<color_run>& runs) const;
+    // takes the newest line out if it was wrapped, its line goes on in whatever comes after the scrollback
+    bool pop_wrapped(std::u32string& text, std::vector<color_run>& runs);
+    // joins the lines autowrap cut and cuts them again every width codepoints, at most MAX_LINE_CHARS;
+    // the oldest ones go if that makes more than depth() lines
+    void rewrap(std::size_t width);
+
+    // f(const color_run&) for every run of every line kept, in no particular order
+    template<typename F>
+    void for_each_run(F&& f) const
+    {
+        for(const auto& l : lines)
+        {
+            const char* packed = l.data.data() + l.text_bytes;
+            for(std::size_t i = 0; i < l.run_count; ++i)
+            {
+                color_run run;
+                std::memcpy(&run, packed + i * sizeof(color_run), sizeof(color_run));
+                f(run);
+            }
+        }
+    }
+
+    // bytes held by the ring itself and every packed line
+    std::size_t memory_usage() const;
+    // upper bound of what a single line can cost
+    static constexpr std::size_t max_line_bytes()
+    {
+        return sizeof(line) + MAX_LINE_CHARS * 4 + MAX_LINE_RUNS * sizeof(color_run);
+    }
+
+private:
+    struct line {
+        std::string data;
+        u16 text_bytes;
+        u8 run_count;
+        bool wrapped;
+    };
+
+    line& next_line();
+    void push_packed(std::string_view text, std::span<const color_run> runs, bool wrapped);
+
+    std::vector<line> lines;
+    std::size_t max_depth;
+    std::size_t head{0};
+    std::size_t count{0};
+};
@@ -0,0 +1,132 @@
+#include "utf8_decoder.h"
+#include <algorithm>
+#include <cstring>
+
+// how many leading bytes are plain ASCII, a machine word at a time
+static std::size_t ascii_run_length(const char* begin, const char* end)
+{
+    using word = uintptr_t;
+    constexpr word HIGHS = ~word(0) / 0xff * 0x80;
+    const char* ptr = begin;
+    while(std::size_t(end - ptr) >= sizeof(word))
+    {
+        word w;
+        std::memcpy(&w, ptr, sizeof(word));
+        if(w & HIGHS)
+            break;
+        ptr += sizeof(word);
+    }
+    while(ptr != end && !(u8(*ptr) & 0x80))
+        ++ptr;
+    return ptr - begin;
+}
+
+void utf8_decoder::decode(std::string_view in, std::u32string& out)
+{
+    const char* ptr = in.data();
+    const char* const end = ptr + in.size();
+    while(ptr != end)
+    {
+        if(!needed)
+        {
+            if(const std::size_t run = ascii_run_length(ptr, end))
+            {
+                const auto old_size = out.size();
+                out.resize(old_size + run);
+                std::copy_n((const u8*)ptr, run, out.begin() + old_size);
+                ptr += run;
+                continue;
+            }
+
+            const u8 lead = *ptr++;
+            if((lead & 0xe0) == 0xc0)
+            {
+                codepoint = lead & 0x1f;
+                min_value = 0x80;
+                needed = 1;
+            }
+            else if((lead & 0xf0) == 0xe0)
+            {
+                codepoint = lead & 0x0f;
+                min_value = 0x800;
+                needed = 2;
+            }
+            else if((lead & 0xf8) == 0xf0)
+            {
+                codepoint = lead & 0x07;
+                min_value = 0x10000;
+                needed = 3;
+            }
+            else
+            {
+                // stray continuation byte or invalid lead
+                out.push_back(REPLACEMENT);
+            }
+            continue;
+        }
+
+        const u8 cont = *ptr;
+        if((cont & 0xc0) != 0x80)
+        {
+            // cut short, the byte starts something new
+            interrupt(out);
+            continue;
+        }
+        ++ptr;
+
+        codepoint = (codepoint << 6) | (cont & 0x3f);
+        if(--needed == 0)
+        {
+            const bool overlong = codepoint < min_value;
+            const bool surrogate = codepoint >= 0xd800 && codepoint <= 0xdfff;
+            out.push_back((overlong || surrogate || codepoint > 0x10ffff) ? REPLACEMENT : codepoint);
+        }
+    }
+}
+
+std::size_t utf8_decoder::encode(char32_t c, char* out)
+{
+    if(c < 0x80)
+    {
+        out[0] = c;
+        return 1;
+    }
+    else if(c < 0x800)
+    {
+        out[0] = 0xc0 | (c >> 6);
+        out[1] = 0x80 | (c & 0x3f);
+        return 2;
+    }
+    else if(c < 0x10000)
+    {
+        if(c >= 0xd800 && c <= 0xdfff)
+            return 0;
+        out[0] = 0xe0 | (c >> 12);
+        out[1] = 0x80 | ((c >> 6) & 0x3f);
+        out[2] = 0x80 | (c & 0x3f);
+        return 3;
+    }
+    else if(c <= 0x10ffff)
+    {
+        out[0] = 0xf0 | (c >> 18);
+        out[1] = 0x80 | ((c >> 12) & 0x3f);
+        out[2] = 0x80 | ((c >> 6) & 0x3f);
+        out[3] = 0x80 | (c & 0x3f);
+        return 4;
+    }
+    return 0;
+}
+
+void utf8_decoder::interrupt(std::u32string& out)
+{
+    if(needed)
+    {
+        needed = 0;
+        out.push_back(REPLACEMENT);
+    }
+}
+
+bool utf8_decoder::pending() const
+{
+    return needed != 0;
+}
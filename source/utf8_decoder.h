@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string_view>
+#include <string>
+
+#include "platform.h"
+
+// incremental UTF-8 to UTF-32, a sequence may be split over any number of decode() calls
+// malformed input comes out as U+FFFD, one per offending sequence
+struct utf8_decoder {
+    static constexpr inline char32_t REPLACEMENT = 0xfffd;
+    // writes up to 4 bytes, returns how many; 0 for something that isn't a codepoint
+    static std::size_t encode(char32_t c, char* out);
+
+    // appends what could be decoded to out, keeps an incomplete trailing sequence for later
+    void decode(std::string_view in, std::u32string& out);
+    // the sequence in progress can't be completed anymore
+    void interrupt(std::u32string& out);
+    bool pending() const;
+
+private:
+    char32_t codepoint{0};
+    char32_t min_value{0};
+    u8 needed{0};
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <array>
+
+#include "platform.h"
+
+enum class vt_state : u8 {
+    ground,
+    escape,
+    escape_intermediate,
+    csi_entry,
+    csi_param,
+    csi_intermediate,
+    csi_ignore,
+    string, // OSC, DCS, SOS, PM and APC payloads, all ignored until BEL or ST
+    count,
+};
+enum class vt_action : u8 {
+    none,
+    print,
+    execute,
+    clear,
+    collect,
+    param,
+    esc_dispatch,
+    csi_dispatch,
+};
+
+static inline constexpr u8 vtTableEntry(vt_action a, vt_state s)
+{
+    return (static_cast<u8>(a) << 4) | static_cast<u8>(s);
+}
+static inline constexpr std::array<std::array<u8, 256>, static_cast<std::size_t>(vt_state::count)> buildVtTable()
+{
+    std::array<std::array<u8, 256>, static_cast<std::size_t>(vt_state::count)> table{};
+    const auto range = [&table](vt_state s, unsigned from, unsigned to, vt_action a, vt_state next) {
+        for(unsigned b = from; b <= to; ++b)
+            table[static_cast<u8>(s)][b] = vtTableEntry(a, next);
+    };
+
+    for(u8 i = 0; i < static_cast<u8>(vt_state::count); ++i)
+    {
+        const auto s = static_cast<vt_state>(i);
+        // by default bytes are dropped without leaving the state
+        range(s, 0x00, 0xff, vt_action::none, s);
+        if(s != vt_state::string)
+        {
+            // C0 controls run even in the middle of a sequence
+            range(s, 0x00, 0x17, vt_action::execute, s);
+            range(s, 0x19, 0x19, vt_action::execute, s);
+            range(s, 0x1c, 0x1f, vt_action::execute, s);
+        }
+        // CAN and SUB abort, ESC restarts, from anywhere
+        range(s, 0x18, 0x18, vt_action::execute, vt_state::ground);
+        range(s, 0x1a, 0x1a, vt_action::execute, vt_state::ground);
+        range(s, 0x1b, 0x1b, vt_action::clear, vt_state::escape);
+    }
+
+    range(vt_state::ground, 0x20, 0x7e, vt_action::print, vt_state::ground);
+    range(vt_state::ground, 0x80, 0xff, vt_action::print, vt_state::ground);
+
+    range(vt_state::escape, 0x20, 0x2f, vt_action::collect, vt_state::escape_intermediate);
+    range(vt_state::escape, 0x30, 0x7e, vt_action::esc_dispatch, vt_state::ground);
+    range(vt_state::escape, '[', '[', vt_action::clear, vt_state::csi_entry);
+    range(vt_state::escape, ']', ']', vt_action::none, vt_state::string);
+    range(vt_state::escape, 'P', 'P', vt_action::none, vt_state::string);
+    range(vt_state::escape, 'X', 'X', vt_action::none, vt_state::string);
+    range(vt_state::escape, '^', '_', vt_action::none, vt_state::string);
+
+    range(vt_state::escape_intermediate, 0x20, 0x2f, vt_action::collect, vt_state::escape_intermediate);
+    range(vt_state::escape_intermediate, 0x30, 0x7e, vt_action::esc_dispatch, vt_state::ground);
+
+    range(vt_state::csi_entry, 0x20, 0x2f, vt_action::collect, vt_state::csi_intermediate);
+    range(vt_state::csi_entry, 0x30, 0x3b, vt_action::param, vt_state::csi_param);
+    range(vt_state::csi_entry, 0x3c, 0x3f, vt_action::collect, vt_state::csi_param);
+    range(vt_state::csi_entry, 0x40, 0x7e, vt_action::csi_dispatch, vt_state::ground);
+
+    range(vt_state::csi_param, 0x20, 0x2f, vt_action::collect, vt_state::csi_intermediate);
+    range(vt_state::csi_param, 0x30, 0x3b, vt_action::param, vt_state::csi_param);
+    range(vt_state::csi_param, 0x3c, 0x3f, vt_action::none, vt_state::csi_ignore);
+    range(vt_state::csi_param, 0x40, 0x7e, vt_action::csi_dispatch, vt_state::ground);
+
+    range(vt_state::csi_intermediate, 0x20, 0x2f, vt_action::collect, vt_state::csi_intermediate);
+    range(vt_state::csi_intermediate, 0x30, 0x3f, vt_action::none, vt_state::csi_ignore);
+    range(vt_state::csi_intermediate, 0x40, 0x7e, vt_action::csi_dispatch, vt_state::ground);
+
+    range(vt_state::csi_ignore, 0x40, 0x7e, vt_action::none, vt_state::ground);
+
+    range(vt_state::string, 0x07, 0x07, vt_action::none, vt_state::ground);
+
+    return table;
+}
+
+// byte-at-a-time escape sequence parser, after the DEC VT500 state diagram
+// all of its state lives here, so a sequence may be split over any number of feed() calls
+// bytes 0x80 and up are passed through as printable, they are UTF-8 and not C1 controls
+struct vt_parser {
+    static constexpr inline std::size_t MAX_PARAMS = 16;
+    static constexpr inline std::size_t MAX_INTERMEDIATES = 2;
+    // larger values are clamped while they are read
+    static constexpr inline unsigned MAX_PARAM_VALUE = 0xffff;
+    // low nibble is the next state, high nibble the action to run on the way
+    static constexpr inline auto TABLE = buildVtTable();
+
+    // Handler gets on_print(std::string_view), on_execute(char), on_esc(const vt_parser&, char) and on_csi(const vt_parser&, char)
+    // printable text reaches on_print in runs as long as possible, never split by the parser itself
+    template<typename Handler>
+    void feed(std::string_view str, Handler& handler)
+    {
+        const char* ptr = str.data();
+        const char* const end = ptr + str.size();
+        while(ptr != end)
+        {
+            if(current == vt_state::ground)
+            {
+                if(const std::size_t run = plain_run_length(ptr, end))
+                {
+                    handler.on_print(std::string_view(ptr, run));
+                    ptr += run;
+                    continue;
+                }
+            }
+
+            const char chr = *ptr++;
+            const u8 transition = TABLE[static_cast<u8>(current)][static_cast<u8>(chr)];
+            current = static_cast<vt_state>(transition & 0xf);
+            switch(static_cast<vt_action>(transition >> 4))
+            {
+            case vt_action::none:
+                break;
+            case vt_action::print:
+                handler.on_print(std::string_view(&chr, 1));
+                break;
+            case vt_action::execute:
+                handler.on_execute(chr);
+                break;
+            case vt_action::clear:
+                param_count = 0;
+                intermediate_count = 0;
+                params_full = false;
+                params.fill(0);
+                break;
+            case vt_action::collect:
+                if(intermediate_count < MAX_INTERMEDIATES)
+                    intermediates[intermediate_count++] = chr;
+                break;
+            case vt_action::param:
+                add_param_byte(chr);
+                break;
+            case vt_action::esc_dispatch:
+                handler.on_esc(*this, chr);
+                break;
+            case vt_action::csi_dispatch:
+                handler.on_csi(*this, chr);
+                break;
+            }
+        }
+    }
+
+    vt_state current_state() const
+    {
+        return current;
+    }
+    std::size_t param_total() const
+    {
+        return param_count;
+    }
+    // missing and zero parameters both read as def, which is what every sequence we handle wants
+    unsigned param(std::size_t idx, unsigned def) const
+    {
+        return (idx < param_count && params[idx]) ? params[idx] : def;
+    }
+    // intermediate bytes and private markers ('?', '>', ...), in order
+    std::string_view collected() const
+    {
+        return {intermediates.data(), intermediate_count};
+    }
+
+    // how many bytes from the start are printable in the ground state: not C0, not DEL
+    static std::size_t plain_run_length(const char* begin, const char* end)
+    {
+        // a word at a time while no byte in it is below 0x20 or equal to 0x7f
+        using word = uintptr_t;
+        constexpr word ONES = ~word(0) / 0xff;
+        constexpr word HIGHS = ONES * 0x80;
+        const char* ptr = begin;
+        while(std::size_t(end - ptr) >= sizeof(word))
+        {
+            word w;
+            std::memcpy(&w, ptr, sizeof(word));
+            const word below_space = (w - ONES * 0x20) & ~w & HIGHS;
+            const word del = w ^ (ONES * 0x7f);
+            const word is_del = (del - ONES) & ~del & HIGHS;
+            if(below_space | is_del)
+                break;
+            ptr += sizeof(word);
+        }
+        while(ptr != end && u8(*ptr) >= 0x20 && *ptr != 0x7f)
+            ++ptr;
+        return ptr - begin;
+    }
+
+private:
+    void add_param_byte(char chr)
+    {
+        if(param_count == 0)
+            param_count = 1;
+
+        // ':' sub-parameters are flattened, so 38:2:r:g:b reads like 38;2;r;g;b
+        if(chr == ';' || chr == ':')
+        {
+            if(param_count < MAX_PARAMS)
+                param_count += 1;
+            else
+                params_full = true;
+        }
+        // past the last slot parameters are dropped, like the VT500 does, instead of running into the last one
+        else if(!params_full)
+        {
+            auto& p = params[param_count - 1];
+            p = std::min<unsigned>(p * 10 + (chr - '0'), MAX_PARAM_VALUE);
+        }
+    }
+
+    vt_state current{vt_state::ground};
+    std::array<u16, MAX_PARAMS> params{};
+    std::array<char, MAX_INTERMEDIATES> intermediates{};
+    u8 param_count{0};
+    u8 intermediate_count{0};
+    bool params_full{false};
+};